@@ -0,0 +1,80 @@
+#ifndef _bitset_h_
+#define _bitset_h_
+
+#include "matrix.h"
+#include "stats.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+/*
+ *  Exact cover by bitsets, for matrices of at most max_width columns such
+ *  as the pentomino matrix. Every row is a bit vector of its columns padded
+ *  to 1, 2, 4 or 8 words, and each level of the search keeps a packed copy
+ *  of the rows compatible with the rows chosen so far. Choosing a row
+ *  filters them by testing each against it, which is done four words at a
+ *  time with AVX2 where the processor has it and a word at a time
+ *  otherwise. The column counts are kept in bit-sliced counters, so the
+ *  column with the fewest rows is found with a few operations per word.
+ *
+ *  Columns and rows are chosen as by ColumnPolicy::min_size, so solutions
+ *  come in the same order as from SparseMatrix::solve_all. The engine is
+ *  built from the rows of the matrix that are present, with no search
+ *  running on it, and solutions refer to the rows of that matrix. Colors
+ *  and multiplicities are not supported, see suits.
+ */
+
+class BitsetSolver {
+public:
+    static constexpr size_t max_width = 512;
+
+    // Whether m is narrow enough and uses neither colors nor multiplicities
+    static bool suits(const SparseMatrix& m);
+
+    // With simd false the rows are always filtered a word at a time
+    explicit BitsetSolver(SparseMatrix& m, bool simd = true);
+
+    std::vector<HeadNode*> solve();
+    std::vector<std::vector<HeadNode*>> solve_all();
+    std::vector<std::vector<HeadNode*>> solve_up_to(size_t k);
+    size_t count_up_to(size_t k);
+
+    // Call visit with each solution as it is found, until it returns
+    // false, so that solutions need not all be kept
+    void for_each(const std::function<bool(const std::vector<HeadNode*>&)>& visit);
+
+    bool vectorized() const { return use_avx2; }
+
+    SearchStats stats;                 // Accumulated over all searches
+
+private:
+    struct Level {
+        std::vector<std::uint64_t> bits;       // Compatible rows, packed
+        std::vector<Link> ids;                 // Index of each in row_index
+        std::vector<std::uint64_t> uncovered;  // Primary columns left
+        size_t size;                           // Rows in use
+    };
+
+    HeadNode *rows;                    // Rows of the matrix built from
+    std::vector<Link> row_index;       // Row of each bit vector
+    size_t words;                      // Per row
+    bool use_avx2;
+    std::vector<Level> levels;         // Levels[0] holds every row
+    std::vector<std::uint64_t> slices; // Bit-sliced column counts
+    std::vector<Link> chosen;          // Index in row_index at each level
+
+    template<size_t W> Link choose_col(const Level& level, size_t& count);
+    template<size_t W> size_t filter(const Level& level, size_t i, Level& next);
+    template<size_t W, typename Visit> bool search(Visit& visit);
+    template<typename Visit> void run(Visit& visit);
+    std::vector<HeadNode*> solution() const;
+};
+
+// Call visit with each solution of m until it returns false, searching by
+// BitsetSolver if it suits the matrix and by the links of m otherwise
+void for_each_solution(SparseMatrix& m,
+                       const std::function<bool(const std::vector<HeadNode*>&)>& visit);
+
+#endif
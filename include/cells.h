@@ -0,0 +1,86 @@
+#ifndef _cells_h_
+#define _cells_h_
+
+#include "matrix.h"
+#include "stats.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/*
+ *  Exact cover by Knuth's dancing cells, an alternative to the links of
+ *  SparseMatrix. The options containing each item are a sparse set: one
+ *  contiguous block of the set array, of which the first size entries are
+ *  the options still active, and each node knows its position in its
+ *  item's block. An option is hidden by swapping each of its nodes with
+ *  the last active entry of its item and decrementing the size, and
+ *  restored by incrementing the size again in the reverse order, so
+ *  backtracking only writes sizes. The active primary items are another
+ *  sparse set.
+ *
+ *  An engine is built from the rows of a SparseMatrix that are present,
+ *  with no search running on it, and has its own copy of their structure.
+ *  Solutions refer to the rows of that matrix, as they would from
+ *  SparseMatrix::solve, and a row can be removed from the engine as from
+ *  the matrix, so that it can be reused, say for puzzles with clues.
+ *  Items are chosen as by ColumnPolicy::min_size, but restoring a set does
+ *  not restore its order, so the options of an item may be tried in a
+ *  different order and solutions found in another order. Colors and
+ *  multiplicities are not supported.
+ */
+
+class DancingCells {
+public:
+    explicit DancingCells(SparseMatrix& m);
+
+    // Take the option of a row out of the engine and put it back, as with
+    // SparseMatrix::remove_row, outside a search and in reverse order
+    void remove_row(const HeadNode* row);
+    void replace_row(const HeadNode* row);
+
+    std::vector<HeadNode*> solve();
+    std::vector<std::vector<HeadNode*>> solve_all();
+    std::vector<std::vector<HeadNode*>> solve_up_to(size_t k);
+    size_t count_up_to(size_t k);
+
+    SearchStats stats;                 // Accumulated over all searches
+
+private:
+    struct Cell {
+        std::int32_t item;             // Minus one more than the index of
+                                       // the following option for a spacer
+        Link loc;                      // Index in set
+    };
+
+    struct Block {
+        Link start;                    // First entry of the item in set
+        Link size;                     // Active entries
+    };
+
+    HeadNode *rows;                    // Rows of the matrix built from
+    std::vector<Link> row_index;       // Row of each option
+    std::vector<Link> option_of;       // First node of the option of each
+                                       // row, 0 if it has none
+    std::vector<Cell> cells;           // Options one after another
+    std::vector<Link> set;             // Nodes of the options of each item
+    std::vector<Block> blocks;         // Options of each item in set
+    std::vector<Link> items;           // Active primary items first
+    std::vector<Link> item_pos;        // Index of each item in items
+    Link num_primary;
+    Link active;
+    std::vector<Link> chosen;          // Node of the option at each level
+
+    Link choose_item() const;
+    void remove(Link y);
+    void hide(Link x);
+    void unhide(Link x);
+    void cover(Link item);
+    void uncover(Link item);
+    void choose(Link x);
+    void unchoose(Link x);
+    template<typename Visit> bool search(Visit& visit);
+    std::vector<HeadNode*> solution() const;
+};
+
+#endif
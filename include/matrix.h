@@ -2,36 +2,306 @@
 #define _matrix_h_
 
 #include "node.h"
+#include "stats.h"
 
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
-#include <memory>
+#include <initializer_list>
+#include <iterator>
+#include <random>
 #include <set>
 #include <vector>
 
+class Solutions;
+
+enum class ColumnPolicy {
+    min_size,                          // Fewest nodes, leftmost on ties
+    random_min,                        // Fewest nodes, random on ties
+    first,                             // Leftmost column
+};
+
+/*
+ *  Bounds on the work of one call to solve or solve_all. The node limit is
+ *  exact, while updates and the deadline are checked every limit_interval
+ *  nodes and after each solution, so a call may overrun them by that much.
+ *  A call stopped by a limit returns the solutions found so far with the
+ *  matrix fully restored, so it can be reused at once.
+ */
+
+struct Limits {
+    std::uint64_t nodes = -1;          // Search nodes visited
+    std::uint64_t updates = -1;        // Nodes removed from or replaced in
+                                       // a column
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::time_point::max();
+};
+
+struct SolveResult {
+    enum Status {
+        solved,                        // Found the solution asked for
+        exhausted,                     // Searched the whole tree
+        limit_hit,                     // Stopped by a limit
+    };
+
+    Status status;
+    std::vector<std::vector<HeadNode*>> solutions;
+    std::uint64_t nodes;               // Work done by the call
+    std::uint64_t updates;
+};
+
+/*
+ *  The nodes of a matrix of fixed shape, which can be computed at compile
+ *  time. Rows are added as by SparseMatrix::add_row, giving the same links,
+ *  and a SparseMatrix is then created from the layout by copying the arrays.
+ */
+
+template<size_t height, size_t width, size_t nonzeros>
+struct MatrixLayout {
+    Node nodes[width + 2 + nonzeros + height];
+    ColNode cols[width + 1];
+    HeadNode rows[height];
+    size_t num_nodes, num_rows;
+
+    constexpr MatrixLayout()
+    : nodes()
+    , cols()
+    , rows()
+    , num_nodes(width + 2)
+    , num_rows(0) {
+        for (Link j = 0; j <= width; ++j) {
+            nodes[j] = {j, j, 0};
+            cols[j] = {j == 0 ? Link(width) : j - 1,
+                       j == width ? 0 : j + 1};
+        }
+        nodes[width + 1] = {0, 0, 0};
+    }
+
+    constexpr void add_row(size_t data, const int *col_nums, size_t count) {
+        Link first = num_nodes;
+        rows[num_rows++] = {data, first};
+        for (size_t k = 0; k < count; ++k) {
+            Link col = col_nums[k] + 1;
+            nodes[num_nodes] = {nodes[col].above, col, int32_t(col)};
+            nodes[nodes[col].above].below = num_nodes;
+            nodes[col].above = num_nodes++;
+            ++nodes[col].top;
+        }
+        nodes[first - 1].below = num_nodes - 1;
+        nodes[num_nodes++] = {first, 0, -int32_t(num_rows)};
+    }
+};
+
 struct SparseMatrix {
     SparseMatrix(size_t height, size_t width,
                  std::function<bool (size_t, size_t)> pred);
 
     SparseMatrix(size_t width);
+    SparseMatrix(size_t primary, size_t secondary);
+    template<size_t height, size_t width, size_t nonzeros>
+    explicit SparseMatrix(const MatrixLayout<height, width, nonzeros>& layout);
     void create_row(size_t data, const std::set<int>& elems);
 
-    std::unique_ptr<HeadNode> head;
-    std::vector<std::unique_ptr<HeadNode>> cols;
-    std::vector<HeadNode*> rows;
+    // Rows are built from their column numbers, which must be distinct,
+    // in time proportional to the number of nodes. Reserving space for
+    // the rows and nodes first avoids reallocating as they are added.
+    void reserve(size_t height, size_t nonzeros);
+    template<typename Range> void add_row(size_t data, const Range& cols);
+    void add_row(size_t data, std::initializer_list<size_t> cols);
+
+    // Secondary columns come after the primary ones and are covered at
+    // most once. A node in a secondary column may have a color greater
+    // than zero, and then rows agreeing on the color can share the column.
+    template<typename Range, typename ColorRange>
+    void add_row(size_t data, const Range& cols, const ColorRange& col_colors);
+
+    // A primary column may instead be covered by between lo and hi rows,
+    // where 1 <= hi. The search branches on how many more rows to choose
+    // in a column, so rows sharing it are never tried in different orders.
+    void set_multiplicity(size_t col_num, size_t lo, size_t hi);
+
+    // Links are indices into the arrays, so a copy is an independent matrix
+    // made by copying the arrays, and can be taken at any point to be used
+    // by another thread. Solutions refer to the rows of the matrix that
+    // found them. reset restores every row and column removed since the
+    // matrix was built, for example by an abandoned search.
+    void reset();
+
+    static constexpr Link root = 0;    // Root of the column list
+
+    std::vector<Node> nodes;
+    std::vector<ColNode> cols;         // Indexed by column header
+    std::vector<HeadNode> rows;
+    Link first_secondary;              // Headers from here on are secondary
+
+    // Color of each node, empty if no node has one. While a row is chosen,
+    // other nodes known to have the right color are marked -1, and the
+    // header of a secondary column holds the color it was given.
+    std::vector<std::int32_t> colors;
 
-    void remove_col_and_rows(HeadNode*);
-    void replace_col_and_rows(HeadNode*);
-    void remove_row(Node*);
-    void replace_row(Node*);
-    HeadNode *min_col() const;
+    // Rows that may still cover each column and the difference between its
+    // upper and lower bounds, empty if every column is covered once
+    std::vector<Link> bounds;
+    std::vector<Link> slacks;
+    std::vector<Link> upper;           // Bounds before searching
+
+    ColumnPolicy policy;
+    std::minstd_rand rng;              // Used by ColumnPolicy::random_min
+    SearchStats stats;                 // Accumulated over all searches
+    std::uint64_t link_updates;        // As stats.updates, but always
+                                       // counted, for Limits
+
+    void remove_from_col(Link);
+    void replace_in_col(Link);
+    void remove_col_and_rows(Link);
+    void replace_col_and_rows(Link);
+    void remove_row(const HeadNode*);
+    void replace_row(const HeadNode*);
+    void choose_row(Link);
+    void unchoose_row(Link);
+    void purify(Link);
+    void unpurify(Link);
+
+    // Branching on a column with multiplicities, following Knuth's
+    // Algorithm M. Rows tried at a level are tweaked out of the column so
+    // deeper levels only choose later ones, and once none are left the
+    // column may be skipped if its lower bound has been met.
+    std::int32_t branches(Link col) const;
+    void enter_col(Link col);
+    void leave_col(Link col, Link first);
+    bool enough_rows(Link col) const;
+    void tweak_row(Link);
+    bool skip_col(Link col);
+    void unskip_col(Link col);
+
+    Link choose_col();
+    Link min_col();
+    HeadNode *row_of(Link);
 
     bool iterate(std::vector<HeadNode*>& solution);
     void iterate_all(std::vector<std::vector<HeadNode*>>& solutions);
 
     std::vector<HeadNode*> solve();
     std::vector<std::vector<HeadNode*>> solve_all();
+    std::vector<std::vector<HeadNode*>> solve_all(unsigned num_threads);
+
+    // Race one search per seed, each on its own copy of the matrix and
+    // thread. Seed 0 searches as solve does, and any other seed breaks
+    // column ties at random and shuffles the rows of each column. The
+    // search reaching a solution in the fewest nodes wins, the first seed
+    // on ties, so the result depends only on the seeds. There must be at
+    // least one seed and fewer than 65536, or std::invalid_argument is
+    // thrown.
+    std::vector<HeadNode*> solve_race(const std::vector<unsigned>& seeds);
+    std::vector<std::vector<HeadNode*>> solve_up_to(size_t k);
+    size_t count_up_to(size_t k);
+    SolveResult solve(const Limits& limits);
+    SolveResult solve_all(const Limits& limits);
+    Solutions solutions();             // Defined in search.h
+
+private:
+    static constexpr size_t limit_interval = 1024;
+
+    void iterate_limited(const Limits& limits, size_t max_solutions,
+                         SolveResult& result);
+    void begin_row(size_t data);
+    void append_node(Link col);
+    void end_row();
+
+    Link random_min_col();
+
+    template<bool bucketed> void hide_node(Link);
+    template<bool bucketed> void unhide_node(Link);
+    template<bool bucketed, bool colored> Link hide_others(Link);
+    template<bool bucketed, bool colored> Link unhide_others(Link);
+    template<bool bucketed, bool colored> void hide_rows(Link col);
+    template<bool bucketed, bool colored> void unhide_rows(Link col);
+
+    // Active columns of up to bucket_limit nodes indexed by size, as one
+    // bitset of column headers per size. Built on the first call to min_col
+    // and kept up to date by the node operations from then on. Columns are
+    // larger than this only close to the root of the search tree, where
+    // min_col falls back to a scan. Matrices with at most scan_limit columns
+    // are always scanned, as that is cheaper than maintaining the index.
+    static constexpr Link bucket_limit = 15;
+    static constexpr size_t scan_limit = 128;
+
+    void build_buckets();
+    void bucket_insert(Link col, Link size);
+    void bucket_erase(Link col, Link size);
+
+    std::vector<std::uint64_t> bucket_bits;
+    std::vector<Link> bucket_sizes;    // Number of columns of each size
+    size_t bucket_words;
+    Link bucket_min;                   // No smaller non-empty bucket
+
+    std::vector<Link> tweaked;         // Rows tweaked out, deepest last
 };
 
-#endif
+template<size_t height, size_t width, size_t nonzeros>
+SparseMatrix::SparseMatrix(const MatrixLayout<height, width, nonzeros>& layout)
+: nodes(layout.nodes, layout.nodes + layout.num_nodes)
+, cols(layout.cols, layout.cols + width + 1)
+, rows(layout.rows, layout.rows + layout.num_rows)
+, first_secondary(width + 1)
+, colors()
+, bounds()
+, slacks()
+, upper()
+, policy(ColumnPolicy::min_size)
+, rng()
+, stats()
+, link_updates(0)
+, bucket_bits()
+, bucket_sizes()
+, bucket_words(0)
+, bucket_min(0)
+, tweaked() {
+}
+
+template<typename Range>
+void SparseMatrix::add_row(size_t data, const Range& col_nums) {
+    begin_row(data);
+    for (auto col_num : col_nums) {
+        append_node(Link(col_num) + 1);
+    }
+    end_row();
+}
 
+template<typename Range, typename ColorRange>
+void SparseMatrix::add_row(size_t data, const Range& col_nums,
+                           const ColorRange& col_colors) {
+    for (auto c : col_colors) {
+        if (c != 0 and colors.empty()) {
+            colors.assign(nodes.size(), 0);
+        }
+    }
+    begin_row(data);
+    auto color = std::begin(col_colors);
+    for (auto col_num : col_nums) {
+        append_node(Link(col_num) + 1);
+        if (*color != 0) {
+            colors.back() = *color;
+        }
+        ++color;
+    }
+    end_row();
+}
+
+inline void SparseMatrix::add_row(size_t data, std::initializer_list<size_t> col_nums) {
+    add_row<std::initializer_list<size_t>>(data, col_nums);
+}
+
+inline std::int32_t SparseMatrix::branches(Link col) const {
+/* Number of ways to go on from col: a row for each node, less those that
+ * would leave too few to meet its lower bound, and one for choosing no
+ * more rows once the lower bound is met */
+    if (bounds.empty()) {
+        return nodes[col].top;
+    }
+    std::int32_t need = std::int32_t(bounds[col]) - std::int32_t(slacks[col]);
+    return nodes[col].top + 1 - (need > 0 ? need : 0);
+}
+
+#endif
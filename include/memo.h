@@ -0,0 +1,99 @@
+#ifndef _memo_h_
+#define _memo_h_
+
+#include "matrix.h"
+#include "stats.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/*
+ *  Natural numbers of any size, enough to count the solutions of a matrix.
+ */
+
+class Natural {
+public:
+    Natural(std::uint64_t n = 0);
+
+    Natural& operator+=(const Natural& other);
+    bool operator==(const Natural& other) const { return limbs == other.limbs; }
+    bool operator!=(const Natural& other) const { return limbs != other.limbs; }
+
+    std::string to_string() const;     // In decimal
+
+private:
+    std::vector<std::uint32_t> limbs;  // Least significant first, no
+                                       // leading zeros
+};
+
+/*
+ *  Zero-suppressed decision diagram of a family of solutions. Each node
+ *  stands for the solutions of its lo node and those of its hi node with
+ *  its row added. Nodes 0 and 1 are the terminals, for no solutions and
+ *  for the empty solution, and every other node comes after its children.
+ *  Nodes are shared, but rows are not in a fixed order along each path.
+ */
+
+struct Zdd {
+    struct Node {
+        Link row;                      // Index in the rows of the matrix
+        size_t lo, hi;
+    };
+
+    std::vector<Node> nodes;
+    size_t root;
+    HeadNode *rows;                    // Rows of the matrix built from
+
+    Natural count() const;
+    std::vector<std::vector<HeadNode*>> solutions() const;
+};
+
+/*
+ *  Counting exact covers by Nishino et al.'s DXZ, the links search with
+ *  memoization. The rows left below a node of the search tree depend only
+ *  on the columns covered so far, so the result for each set of covered
+ *  columns is kept in a cache and a repeated set is answered from it
+ *  without searching the subtree again. The cache is a table of a fixed
+ *  number of slots given by a budget in bytes, and a set whose slot is
+ *  taken replaces the one in it, so a small budget costs time rather than
+ *  exactness. Counts are exact however large. zdd gives every solution as
+ *  a decision diagram, whose size follows the number of distinct subtrees
+ *  rather than the number of solutions.
+ *
+ *  Columns are chosen by the policy of the matrix, which is left as it was
+ *  found. Colors and multiplicities are not supported, and the cache is
+ *  cleared by every call, as the matrix may have changed in between.
+ */
+
+class MemoCounter {
+public:
+    explicit MemoCounter(SparseMatrix& m_, size_t memo_bytes = size_t(64) << 20);
+
+    Natural count();
+    Zdd zdd();
+
+    SearchStats stats;                 // Accumulated over all searches
+    std::uint64_t hits;                // Subtrees answered from the cache
+    std::uint64_t misses;
+
+private:
+    template<typename Value> class Memo;
+
+    SparseMatrix& m;
+    size_t memo_bytes;
+    size_t words;                      // Of a set of columns
+    std::vector<std::uint64_t> covered;
+    Zdd diagram;                       // Built by zdd
+    std::map<std::tuple<Link, size_t, size_t>, size_t> unique;
+
+    void cover_row(Link x, bool set);
+    size_t make_node(Link row, size_t lo, size_t hi);
+    Natural count(Memo<Natural>& memo, size_t depth);
+    size_t zdd(Memo<size_t>& memo, size_t depth);
+};
+
+#endif
@@ -1,43 +1,36 @@
 #ifndef _node_h_
 #define _node_h_
 
+#include <cstdint>
 #include <cstdlib>
-#include <iostream>
 
-class HeadNode;
+/*
+ *  Nodes live in one contiguous arena owned by a SparseMatrix and refer to
+ *  each other by 32 bit index. Following Knuth's DLX2 layout, indices
+ *  [1, width] are the column headers and the nodes of each row are adjacent,
+ *  with a spacer node between consecutive rows.
+ */
 
-class Node {
-public:
-	Node(HeadNode *col_, HeadNode *row_);
-	~Node();
+using Link = std::uint32_t;
 
-	HeadNode *const col, *const row;
-	Node *above, *below, *left, *right;
+struct Node {
+	Link above, below;
 
-	void remove_from_col();
-	void remove_from_row(); 
-	void replace_in_col();
-	void replace_in_row();
-
-protected:
-	Node(HeadNode *col_, HeadNode *row_,       // For use by HeadNode
-	     Node *above_, Node *below_,
-	     Node *left, Node *right);
+	// For a row node the index of its column header, for a column header the
+	// number of nodes in the column. Spacers hold minus the index of the row
+	// that follows them, so that top <= 0 marks the end of a row. The above
+	// link of a spacer is the first node of the previous row and the below
+	// link is the last node of the next row.
+	std::int32_t top;
 };
 
-class HeadNode : public Node {
-public:
-	HeadNode();                                // Head constructor
-	HeadNode(HeadNode *row_);                  // Col constructor
-	HeadNode(HeadNode *col_, size_t data_);    // Row constructor
-    ~HeadNode();
+struct ColNode {                 // Horizontal links of a column header
+	Link left, right;
+};
 
+struct HeadNode {                // Row header
 	size_t data;
-
-	bool is_col() const;
-	bool is_row() const;
-	bool is_head() const;
+	Link first;                  // First node of the row in the arena
 };
 
 #endif
-
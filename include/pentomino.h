@@ -3,7 +3,9 @@
 
 #include "matrix.h"
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 /*  Find all tilings of the chessboard with centre removed by the 12
  *  pentominoes
@@ -36,7 +38,7 @@ struct Pentomino {
     char name;
 };
 
-inline Position apply_transform(Position p, int rotation, bool reflect) {
+constexpr Position apply_transform(Position p, int rotation, bool reflect) {
     if (reflect) {
         p.x = -p.x;
     }
@@ -52,7 +54,7 @@ inline Position apply_transform(Position p, int rotation, bool reflect) {
     }
 }
 
-inline Pentomino transform_pentomino(const Pentomino& p, int rotation, bool reflect) {
+constexpr Pentomino transform_pentomino(const Pentomino& p, int rotation, bool reflect) {
     return {
         {
             apply_transform(p.squares[0], rotation, reflect),
@@ -67,7 +69,7 @@ inline Pentomino transform_pentomino(const Pentomino& p, int rotation, bool refl
 }
 
 
-const Pentomino base_pentominoes[12] = {
+constexpr Pentomino base_pentominoes[12] = {
     {{{0, 0}, {1, 0}, {1, 1}, {2, 1}, {1, 2}}, 0, 'F'},
     {{{0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}}, 1, 'I'},
     {{{0, 0}, {1, 0}, {1, 1}, {1, 2}, {1, 3}}, 2, 'L'},
@@ -82,62 +84,99 @@ const Pentomino base_pentominoes[12] = {
     {{{0, 0}, {1, 0}, {1, 1}, {1, 2}, {2, 2}}, 11, 'Z'},
 };
 
-const std::vector<Pentomino>& fixed_pentominoes() {
-    static auto ret = []{
-        std::vector<Pentomino> v;
-        for (const auto& p : base_pentominoes) {
-            switch (p.name) {
-                case 'F':
-                case 'L':
-                case 'N':
-                case 'P':
-                case 'Y':    // All rotations and reflections
-                    v.push_back(transform_pentomino(p, 1, true));
-                    v.push_back(transform_pentomino(p, 2, true));
-                    v.push_back(transform_pentomino(p, 3, true));
-                    v.push_back(transform_pentomino(p, 4, true));
-                case 'T':
-                case 'U':
-                case 'V':
-                case 'W':    // All rotations
-                    v.push_back(transform_pentomino(p, 0, false));
-                    v.push_back(transform_pentomino(p, 1, false));
-                    v.push_back(transform_pentomino(p, 2, false));
-                    v.push_back(transform_pentomino(p, 3, false));
-                    break;
-                case 'Z':    // Rotate by 90 degrees and reflection
-                    v.push_back(transform_pentomino(p, 0, true));
-                    v.push_back(transform_pentomino(p, 1, true));
-                case 'I':     // Rotate by 90 degrees
-                    v.push_back(transform_pentomino(p, 1, false));
-                case 'X':     // No transforms
-                    v.push_back(transform_pentomino(p, 0, false));
+// The 63 orientations of the pentominoes, computed at compile time so that
+// they are shared by every thread without being written at run time
+struct FixedPentominoes {
+    Pentomino items[63];
+
+    constexpr const Pentomino& operator[](size_t i) const { return items[i]; }
+    constexpr const Pentomino *begin() const { return items; }
+    constexpr const Pentomino *end() const { return items + 63; }
+};
+
+constexpr FixedPentominoes make_fixed_pentominoes() {
+    FixedPentominoes ret{};
+    size_t n = 0;
+    for (const auto& p : base_pentominoes) {
+        switch (p.name) {
+            case 'F':
+            case 'L':
+            case 'N':
+            case 'P':
+            case 'Y':    // All rotations and reflections
+                ret.items[n++] = transform_pentomino(p, 1, true);
+                ret.items[n++] = transform_pentomino(p, 2, true);
+                ret.items[n++] = transform_pentomino(p, 3, true);
+                ret.items[n++] = transform_pentomino(p, 4, true);
+            case 'T':
+            case 'U':
+            case 'V':
+            case 'W':    // All rotations
+                ret.items[n++] = transform_pentomino(p, 0, false);
+                ret.items[n++] = transform_pentomino(p, 1, false);
+                ret.items[n++] = transform_pentomino(p, 2, false);
+                ret.items[n++] = transform_pentomino(p, 3, false);
+                break;
+            case 'Z':    // Rotate by 90 degrees and reflection
+                ret.items[n++] = transform_pentomino(p, 0, true);
+                ret.items[n++] = transform_pentomino(p, 1, true);
+            case 'I':     // Rotate by 90 degrees
+                ret.items[n++] = transform_pentomino(p, 1, false);
+            case 'X':     // No transforms
+                ret.items[n++] = transform_pentomino(p, 0, false);
+        }
+    }
+    return ret;
+}
+
+constexpr FixedPentominoes fixed_pentominoes = make_fixed_pentominoes();
+
+inline std::vector<std::vector<size_t>> board_symmetries() {
+    /* The rotations and reflections of the board as column permutations */
+    std::vector<std::vector<size_t>> ret;
+    for (bool reflect : {false, true}) {
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            std::vector<size_t> perm(72);
+            for (size_t id = 0; id < 12; ++id) {
+                perm[id] = id;
+            }
+            for (int x = 0; x < 8; ++x) {
+                for (int y = 0; y < 8; ++y) {
+                    // Transform about the centre of the board
+                    Position p = apply_transform({2 * x - 7, 2 * y - 7},
+                                                 rotation, reflect);
+                    int col = Position{x, y}.get_col_num();
+                    if (col != 0) {
+                        perm[col] = Position{(p.x + 7) / 2, (p.y + 7) / 2}.get_col_num();
+                    }
+                }
             }
+            ret.push_back(perm);
         }
-        assert(v.size() == 63);
-        return v;
-    }();
+    }
     return ret;
 }
 
-SparseMatrix create_matrix() {
+inline SparseMatrix create_matrix() {
     SparseMatrix ret(72);
+    ret.reserve(1568, 1568 * 6);
     size_t row_id = 0;
-    for (const Pentomino& p : fixed_pentominoes()) {
+    for (const Pentomino& p : fixed_pentominoes) {
         for (int x = 0; x < 8; ++x) {
             for (int y = 0; y < 8; ++y) {
-                std::set<int> cols;
-                for (Position pos : p.squares) {
+                int cols[6];
+                cols[0] = p.id;
+                for (int k = 0; k < 5; ++k) {
+                    Position pos = p.squares[k];
                     pos.x += x;
                     pos.y += y;
-                    int col = pos.get_col_num();
-                    if (col == 0) {
+                    cols[k + 1] = pos.get_col_num();
+                    if (cols[k + 1] == 0) {
                         goto next;
                     }
-                    cols.insert(col);
                 }
-                cols.insert(p.id);
-                ret.create_row(row_id, cols);
+                std::sort(cols, cols + 6);
+                ret.add_row(row_id, cols);
             next:
                 ++row_id;
             }
@@ -0,0 +1,75 @@
+#ifndef _polyomino_h_
+#define _polyomino_h_
+
+#include "matrix.h"
+
+#include <cstdlib>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ *  Tiling of an arbitrary board by a multiset of polyominoes. Boards and
+ *  pieces are drawn as lines of text with '#' for a square and any other
+ *  character for a gap. There is a column for each piece followed by one
+ *  for each square of the board in reading order, and a row for each
+ *  distinct placement of an orientation of a piece. The column of a piece
+ *  with several copies must be covered that many times, so the copies are
+ *  interchangeable and each tiling is found once.
+ */
+
+namespace polyomino {
+
+struct Cell {
+    int x, y;
+};
+
+struct Piece {
+    Piece(char name_, const std::vector<std::string>& drawing, size_t count_ = 1);
+
+    char name;
+    std::vector<Cell> cells;
+    size_t count;                      // Number of copies to place
+};
+
+struct Placement {
+    size_t piece;                      // Index in the piece list
+    std::vector<size_t> squares;       // Indices of the board squares covered
+};
+
+class Tiling {
+public:
+    Tiling(const std::vector<std::string>& board, const std::vector<Piece>& pieces_,
+           bool reflections_ = true);
+
+    size_t width() const { return piece_cols.back() + squares.size(); }
+    size_t nonzeros() const;
+    double density() const;
+    const std::vector<Placement>& placements() const { return rows; }
+    void report(std::ostream& os) const;
+
+    // A row for each placement, with its index as the data
+    size_t height() const { return rows.size(); }
+    SparseMatrix matrix() const;
+    std::string format(const std::vector<HeadNode*>& solution) const;
+
+    // Rotations of the board that map it to itself, and reflections if the
+    // pieces may be reflected, as column permutations for Symmetry
+    std::vector<std::vector<size_t>> symmetries() const;
+
+private:
+    std::vector<Piece> pieces;
+    bool reflections;
+    std::vector<size_t> piece_cols;    // Column of each piece, then the
+                                       // number of them
+    std::vector<Cell> squares;
+    std::vector<int> square_at;        // Square index at each x + y * board_x
+    int board_x, board_y;
+    std::vector<Placement> rows;
+
+    int find_square(Cell c) const;
+};
+
+} // namespace polyomino
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _queue_h_
+#define _queue_h_
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+
+/*
+ *  Fixed capacity multi-producer multi-consumer queue for connecting the
+ *  stages of a pipeline. Once closed, pop drains the remaining items and
+ *  then fails.
+ */
+
+template<typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity_)
+    : capacity(capacity_)
+    , closed(false) {
+    }
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return closed or items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed or not items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+};
+
+#endif
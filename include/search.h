@@ -0,0 +1,124 @@
+#ifndef _search_h_
+#define _search_h_
+
+#include "matrix.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/*
+ *  Non-recursive DLX search over a SparseMatrix. The state of the search is
+ *  an explicit stack with one level per chosen row, so the search can be run
+ *  for a bounded number of nodes and resumed later from the same point. The
+ *  matrix must not be modified by anything else while a search is running;
+ *  it is fully restored when the search is exhausted or destroyed.
+ */
+
+class Search {
+public:
+    enum Status {
+        paused,                  // Node budget used up, call step again
+        found,                   // solution() holds a new solution
+        exhausted,               // No more solutions
+    };
+
+    struct Level {
+        Link col;                // Column covered at this level
+        Link row;                // Node of the row currently chosen
+        Link end;                // Stop at this node, normally col
+        Link first;              // First row of the column on entering
+    };
+
+    Search(SparseMatrix& m_);
+    ~Search();
+
+    Search(const Search&) = delete;
+    Search& operator=(const Search&) = delete;
+
+    Status step(size_t max_nodes = -1);
+    void abort();
+
+    std::vector<HeadNode*> solution() const;
+    void solution(std::vector<HeadNode*>& out) const;
+    const std::vector<Level>& levels() const { return stack; }
+    size_t depth() const { return stack.size(); }
+    size_t nodes() const { return node_count; }
+
+    // Stop exploring the untried rows of the shallowest level that has any
+    // and return them, so another search can take them over. Returns none
+    // for a matrix with multiplicities.
+    std::vector<Link> split(size_t& level);
+
+private:
+    enum State {
+        enter, next_row, backtrack, done
+    };
+
+    SparseMatrix& m;
+    std::vector<Level> stack;
+    State state;
+    size_t node_count;
+};
+
+/*
+ *  Range over the solutions of a matrix, found lazily as the range is
+ *  iterated. Only the current solution is kept, and destroying the range
+ *  part way through stops the search and restores the matrix.
+ */
+
+class Solutions {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::vector<HeadNode*>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        iterator(Solutions *range_)
+        : range(range_) {
+        }
+
+        reference operator*() const { return range->current; }
+        pointer operator->() const { return &range->current; }
+
+        iterator& operator++() {
+            if (not range->advance()) {
+                range = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return range == other.range; }
+        bool operator!=(const iterator& other) const { return range != other.range; }
+
+    private:
+        Solutions *range;
+    };
+
+    Solutions(SparseMatrix& m)
+    : search(new Search(m))
+    , current() {
+    }
+
+    iterator begin() { return iterator(advance() ? this : nullptr); }
+    iterator end() { return iterator(nullptr); }
+
+private:
+    bool advance() {
+        if (search->step() != Search::found) {
+            return false;
+        }
+        search->solution(current);
+        return true;
+    }
+
+    std::unique_ptr<Search> search;
+    std::vector<HeadNode*> current;
+};
+
+#endif
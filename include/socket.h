@@ -0,0 +1,47 @@
+#ifndef _socket_h_
+#define _socket_h_
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/*
+ *  Line-based services on Unix domain sockets. A connection is read and
+ *  written through a SocketBuf, so a session is given ordinary streams.
+ *  Functions returning a descriptor return -1 on failure, with errno set.
+ */
+
+class SocketBuf : public std::streambuf {
+public:
+    explicit SocketBuf(int fd_);       // Takes ownership of fd_
+    ~SocketBuf();
+
+    SocketBuf(const SocketBuf&) = delete;
+    SocketBuf& operator=(const SocketBuf&) = delete;
+
+protected:
+    int underflow() override;
+    int overflow(int c) override;
+    int sync() override;
+
+private:
+    int fd;
+    char in[4096];
+    char out[4096];
+};
+
+// Socket listening at path, which is replaced if it exists
+int listen_unix_socket(const std::string& path);
+
+// Socket connected to the one listening at path
+int connect_unix_socket(const std::string& path);
+
+// Accept connections until the listener fails or is shut down, calling
+// session for each on a thread of its own, which closes the connection
+// once session returns
+void serve_connections(int listener,
+                       std::function<void(std::istream&, std::ostream&)> session);
+
+#endif
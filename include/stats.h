@@ -0,0 +1,82 @@
+#ifndef _stats_h_
+#define _stats_h_
+
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ *  Counters describing the work done by a search. They are only updated
+ *  when compiled with DLX_STATS defined (make STATS=1), otherwise the
+ *  counting code is removed and the counters stay at zero.
+ */
+
+#ifdef DLX_STATS
+#define DLX_COUNT(expr) (expr)
+constexpr bool stats_enabled = true;
+#else
+#define DLX_COUNT(expr) ((void)0)
+constexpr bool stats_enabled = false;
+#endif
+
+struct SearchStats {
+    std::vector<std::uint64_t> nodes_per_depth;
+    std::uint64_t updates = 0;         // Nodes removed from or replaced in a column
+    std::uint64_t branches = 0;        // Rows in the columns branched on
+    std::uint64_t dead_ends = 0;       // Columns chosen with no rows left
+    std::uint64_t solutions = 0;
+
+    void count_node(size_t depth) {
+        if (depth >= nodes_per_depth.size()) {
+            nodes_per_depth.resize(depth + 1, 0);
+        }
+        ++nodes_per_depth[depth];
+    }
+
+    std::uint64_t nodes() const {
+        std::uint64_t ret = 0;
+        for (std::uint64_t n : nodes_per_depth) {
+            ret += n;
+        }
+        return ret;
+    }
+
+    double branching_factor() const {
+        /* Mean number of rows at nodes that were not dead ends */
+        std::uint64_t n = nodes() - dead_ends;
+        return n == 0 ? 0.0 : double(branches) / n;
+    }
+
+    void merge(const SearchStats& other) {
+        if (other.nodes_per_depth.size() > nodes_per_depth.size()) {
+            nodes_per_depth.resize(other.nodes_per_depth.size(), 0);
+        }
+        for (size_t d = 0; d < other.nodes_per_depth.size(); ++d) {
+            nodes_per_depth[d] += other.nodes_per_depth[d];
+        }
+        updates += other.updates;
+        branches += other.branches;
+        dead_ends += other.dead_ends;
+        solutions += other.solutions;
+    }
+
+    std::string to_json() const {
+        std::ostringstream os;
+        os << "{\"nodes\":" << nodes()
+           << ",\"updates\":" << updates
+           << ",\"branches\":" << branches
+           << ",\"branching_factor\":" << branching_factor()
+           << ",\"dead_ends\":" << dead_ends
+           << ",\"solutions\":" << solutions
+           << ",\"nodes_per_depth\":[";
+        for (size_t d = 0; d < nodes_per_depth.size(); ++d) {
+            os << (d == 0 ? "" : ",") << nodes_per_depth[d];
+        }
+        os << "]}";
+        return os.str();
+    }
+};
+
+#endif
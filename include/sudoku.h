@@ -1,14 +1,25 @@
 #ifndef _sudoku_h_
 #define _sudoku_h_
 
+#include "cells.h"
 #include "digit.h"
 #include "matrix.h"
+#include "queue.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 /*  
@@ -44,56 +55,115 @@ inline bool is_clue(const int n) {
  */
 
 template<int sz>
-inline int cell_constraint(int j, int i, int) {
+constexpr int cell_constraint(int j, int i, int) {
 	return i * sz + j;
 }
 template<int sz>
-inline int row_constraint(int, int i, int n) {
+constexpr int row_constraint(int, int i, int n) {
 	return i * sz + n;
 }
 template<int sz>
-inline int col_constraint(int j, int, int n) {
+constexpr int col_constraint(int j, int, int n) {
 	return j * sz + n;
 }
 template<int sz>
-inline int block_constraint(int j, int i, int n) {
-	static int block_width = (sz == 9 ? 3 : 2);
+constexpr int block_constraint(int j, int i, int n) {
+	const int block_width = (sz == 9 ? 3 : 2);
 	int block_num = 3 * (j / 3) + (i / block_width);
 	return block_num * sz + n;
 }
 template<int sz>
-inline int cross_constraint_1(int j, int i, int n) {
+constexpr int cross_constraint_1(int j, int i, int n) {
 	if (j == i) {
 		return (sz + 1) * n;
 	}
 	return j * sz + i;
 }
 template<int sz>
-inline int cross_constraint_2(int j, int i, int n) {
+constexpr int cross_constraint_2(int j, int i, int n) {
 	if (j + i == sz - 1) {
 		return (sz - 1) * (n + 1);
 	}
 	return j * sz + i; 
 }
 
-using ConstraintType = int (*)(int, int, int);
+template<int sz>
+constexpr int constraint(int t, int j, int i, int n) {
+	switch (t) {
+	  case 0: return cell_constraint<sz>(j, i, n);
+	  case 1: return row_constraint<sz>(j, i, n);
+	  case 2: return col_constraint<sz>(j, i, n);
+	  case 3: return block_constraint<sz>(j, i, n);
+	  case 4: return cross_constraint_1<sz>(j, i, n);
+	  default: return cross_constraint_2<sz>(j, i, n);
+	}
+}
+
+/*
+ *  The full constraint matrix, with a row for each digit in each cell and a
+ *  column for each constraint of each type, is generated at compile time
+ *  for every size and rule set it is used with.
+ */
+
+template<int sz, bool use_cross_rule>
+using ConstraintLayout = MatrixLayout<sz * sz * sz,
+                                      sz * sz * (use_cross_rule ? 6 : 4),
+                                      sz * sz * sz * (use_cross_rule ? 6 : 4)>;
+
+template<int sz, bool use_cross_rule>
+constexpr ConstraintLayout<sz, use_cross_rule> make_constraint_layout() {
+	ConstraintLayout<sz, use_cross_rule> ret;
+	const int row_size = use_cross_rule ? 6 : 4;
+	for (int r = 0; r < sz * sz * sz; ++r) {
+		int cols[6] = {};
+		for (int t = 0; t < row_size; ++t) {
+			int i = r / (sz * sz), j = r / sz % sz, n = r % sz;
+			cols[t] = t * sz * sz + constraint<sz>(t, j, i, n);
+		}
+		ret.add_row(r, cols, row_size);
+	}
+	return ret;
+}
+
+template<int sz, bool use_cross_rule>
+constexpr ConstraintLayout<sz, use_cross_rule> constraint_layout =
+	make_constraint_layout<sz, use_cross_rule>();
 
 template<int sz>
-const ConstraintType constraints[] = {
-    cell_constraint<sz>,
-    row_constraint<sz>,
-    col_constraint<sz>,
-    block_constraint<sz>,
-    cross_constraint_1<sz>,
-    cross_constraint_2<sz>,
-};
+inline std::vector<const HeadNode*> clue_rows(const SparseMatrix& M,
+                                              const std::string& puzzle) {
+	/* The rows of a full puzzle_matrix contradicting the clues */
+	std::vector<const HeadNode*> clues;
+	for (int i = 0; i < sz * sz; ++i) {
+		int c = get_num(puzzle[i]);
+		if (is_clue<sz>(c)) {
+			for (int num = 0; num < sz; ++num) {
+				if (c != num) {
+					clues.push_back(&M.rows[sz * i + num]);
+				}
+			}
+		}
+	}
+	return clues;
+}
 
 template<int sz>
-inline bool constraints_matrix(int j_, int i_) {
-    DigitInt<sz, sz, sz> i(i_);
-    DigitInt<6, sz * sz> j(j_);
+inline std::vector<const HeadNode*> remove_clues(SparseMatrix& M,
+                                                 const std::string& puzzle) {
+	/* Remove the rows contradicting the clues from a full puzzle_matrix */
+	std::vector<const HeadNode*> clues = clue_rows<sz>(M, puzzle);
+	for (auto it = clues.begin(); it != clues.end(); ++it) {
+		M.remove_row(*it);
+	}
+	return clues;
+}
 
-    return j[val] == constraints<sz>[j[type]](i[col], i[row], i[num]);
+inline void replace_clues(SparseMatrix& M,
+                          const std::vector<const HeadNode*>& clues) {
+	/* Replace removed rows in reverse order */
+	for (auto it = clues.rbegin(); it != clues.rend(); ++it) {
+		M.replace_row(*it);
+	}
 }
 
 }
@@ -104,15 +174,10 @@ inline std::string format_solution(const std::vector<HeadNode*>& solution) {
 	if (solution.empty()) {
 		return ret;
 	}
-	static int grid[sz][sz];
+	ret.resize(sz * sz);
 	for (HeadNode* n : solution) {
-        DigitInt<9, 9, 9> data(n->data);
-		grid[data.get(row)][data.get(col)] = data.get(num);
-	}
-	for (size_t i = 0; i < sz; ++i) {
-		for (size_t j = 0; j < sz; ++j) {
-			ret += get_char(grid[i][j]);
-		}
+        DigitInt<sz, sz, sz> data(n->data);
+		ret[data.get(row) * sz + data.get(col)] = get_char(data.get(num));
 	}
 	return ret;
 }
@@ -160,67 +225,626 @@ inline void print_grid<6>(const std::string& puzzle, std::ostream& os) {
 	os << "\b└───┴───┘\n";
 }
 
+template<int sz, bool use_cross_rule = false>
+inline SparseMatrix puzzle_matrix(const std::string& puzzle = std::string()) {
+	/* 
+	 *  Constraint matrix with the rows that contradict the clues removed.
+	 *  With no puzzle every row is included, and row i has data i.
+	 */
+	SparseMatrix M(constraint_layout<sz, use_cross_rule>);
+	if (not puzzle.empty()) {
+		remove_clues<sz>(M, puzzle);
+	}
+	return M;
+}
+
+template<int sz, bool use_cross_rule = false>
+inline bool has_unique_solution(const std::string& puzzle) {
+	/* Stops searching as soon as a second solution is found */
+	return puzzle_matrix<sz, use_cross_rule>(puzzle).count_up_to(2) == 1;
+}
+
 template<int sz, bool use_cross_rule = false>
 inline void solve(const std::string& puzzle) {
 	/* Solve a sudoku puzzle given as a string of length sz**2 */
 	std::cout << "Solving puzzle:\n";
 	print_grid<sz>(puzzle, std::cout);
-	int height = sz * sz * sz;
-	int width = sz * sz * (use_cross_rule ? 6 : 4);
-	SparseMatrix M(height, width,
-		[puzzle](size_t j, size_t i) -> bool {
-			int c = get_num(puzzle[i / sz]);
-			if (is_clue<sz>(c) and size_t(c) != (i % sz)) {
-				return false;
-			}
-			return constraints_matrix<sz>(j, i);
-		}
-	);
-	auto solutions = M.solve_all();
+	SparseMatrix M = puzzle_matrix<sz, use_cross_rule>(puzzle);
+	auto solutions = M.solve_up_to(2);
 	if (solutions.size() == 1) {
 		std::cout << "Found solution:\n";
 		print_grid<sz>(format_solution<sz>(solutions.back()), std::cout);
+		std::cout << "Solution is unique\n";
+	} else if (solutions.empty()) {
+		std::cout << "No solutions found\n";
+	} else {
+		std::cout << "Puzzle has more than one solution\n";
 	}
-	std::cout << "Total solutions found: " << solutions.size() << '\n';
 }
 
+enum class Engine {
+	dlx,                     // Exact cover on the constraint matrix
+	bitboard,                // Bitboard with propagation of singles
+	cells,                   // Exact cover by dancing cells
+};
+
+/*
+ *  Sudoku solver working on bitmasks of candidate digits rather than on the
+ *  constraint matrix. Naked and hidden singles are placed until the puzzle
+ *  is solved or stuck, and only then does it branch on the cell with the
+ *  fewest candidates. Solutions are formatted as by format_solution.
+ */
+
 template<int sz, bool use_cross_rule = false>
-inline int solve_file(std::ifstream& infile, std::ofstream& outfile) {
+class Bitboard {
+public:
+	Bitboard() {
+		// Units are the rows, columns and blocks followed by the diagonals
+		int count[num_units] = {};
+		for (int cell = 0; cell < cells; ++cell) {
+			int i = cell / sz, j = cell % sz;
+			int units[] = {
+				i, sz + j, 2 * sz + 3 * (j / 3) + i / block_height,
+				use_cross_rule and i == j ? 3 * sz : -1,
+				use_cross_rule and i + j == sz - 1 ? 3 * sz + 1 : -1,
+			};
+			for (int u : units) {
+				if (u >= 0) {
+					cells_of[u][count[u]++] = cell;
+				}
+			}
+		}
+		for (int cell = 0; cell < cells; ++cell) {
+			num_peers[cell] = 0;
+			for (int u = 0; u < num_units; ++u) {
+				if (std::find(std::begin(cells_of[u]), std::end(cells_of[u]), cell)
+				    == std::end(cells_of[u])) {
+					continue;
+				}
+				for (int peer : cells_of[u]) {
+					int *end = peers[cell] + num_peers[cell];
+					if (peer != cell and std::find(peers[cell], end, peer) == end) {
+						peers[cell][num_peers[cell]++] = peer;
+					}
+				}
+			}
+		}
+		// Each block meets block_height rows and 3 columns
+		int k = 0;
+		for (int b = 2 * sz; b < 3 * sz; ++b) {
+			for (int line = 0; line < 2 * sz; ++line) {
+				Segment& seg = segments[k];
+				seg = Segment{{}, {}, {}, 0, 0, 0};
+				for (int cell : cells_of[b]) {
+					bool shared = std::find(std::begin(cells_of[line]),
+					                        std::end(cells_of[line]), cell)
+					              != std::end(cells_of[line]);
+					if (shared) {
+						seg.shared[seg.num_shared++] = cell;
+					} else {
+						seg.block[seg.num_block++] = cell;
+					}
+				}
+				if (seg.num_shared == 0) {
+					continue;
+				}
+				for (int cell : cells_of[line]) {
+					if (std::find(seg.shared, seg.shared + seg.num_shared, cell)
+					    == seg.shared + seg.num_shared) {
+						seg.line[seg.num_line++] = cell;
+					}
+				}
+				++k;
+			}
+		}
+	}
+
+	std::string solve(const std::string& puzzle) {
+		/*
+		 *  Solution of a puzzle, or an empty string if it has none. Which
+		 *  solution is found first depends on the search order, so when
+		 *  there is more than one the first solution of the constraint
+		 *  matrix is returned instead, as the dlx engine would.
+		 */
+		std::string ret;
+		if (search(puzzle, 2, ret) > 1) {
+			ret = format_solution<sz>(
+				puzzle_matrix<sz, use_cross_rule>(puzzle).solve());
+		}
+		return ret;
+	}
+
+	size_t count_up_to(const std::string& puzzle, size_t k) {
+		/* Number of solutions, stopping once k have been found */
+		std::string first;
+		return search(puzzle, k, first);
+	}
+
+private:
+	using Mask = std::uint16_t;
+
+	static constexpr int cells = sz * sz;
+	static constexpr int block_height = (sz == 9 ? 3 : 2);
+	static constexpr int num_units = 3 * sz + (use_cross_rule ? 2 : 0);
+	static constexpr int max_peers = 5 * (sz - 1);
+	static constexpr Mask all = (1 << sz) - 1;
+
+	struct State {
+		std::int8_t grid[cells];           // Digit in each cell, -1 if empty
+		Mask candidates[cells];            // Digits still possible, 0 if filled
+		int empty;
+	};
+
+	// Cells shared by a block and a row or column, and the other cells
+	// of each
+	struct Segment {
+		int shared[3];
+		int block[sz];
+		int line[sz];
+		int num_shared, num_block, num_line;
+	};
+	static constexpr int num_segments = sz * (block_height + 3);
+
+	struct Level {
+		State state;                       // State before branching
+		int cell;
+		Mask untried;
+	};
+
+	size_t search(const std::string& puzzle, size_t k, std::string& first) {
+		State s;
+		std::fill(std::begin(s.grid), std::end(s.grid), -1);
+		std::fill(std::begin(s.candidates), std::end(s.candidates), all);
+		s.empty = cells;
+		for (int cell = 0; cell < cells; ++cell) {
+			int n = get_num(puzzle[cell]);
+			if (is_clue<sz>(n)) {
+				if (not (s.candidates[cell] & (1 << n))) {
+					return 0;
+				}
+				place(s, cell, n);
+			}
+		}
+
+		size_t count = 0;
+		stack.clear();
+		for (;;) {
+			if (propagate(s)) {
+				if (s.empty > 0) {
+					int cell = fewest_candidates(s);
+					stack.push_back({s, cell, s.candidates[cell]});
+				} else if (count++ == 0) {
+					first.resize(cells);
+					for (int cell = 0; cell < cells; ++cell) {
+						first[cell] = get_char(s.grid[cell]);
+					}
+				}
+				if (count == k) {
+					return count;
+				}
+			}
+			while (not stack.empty() and stack.back().untried == 0) {
+				stack.pop_back();
+			}
+			if (stack.empty()) {
+				return count;
+			}
+			Level& l = stack.back();
+			int n = __builtin_ctz(l.untried);
+			l.untried &= l.untried - 1;
+			s = l.state;
+			place(s, l.cell, n);
+		}
+	}
+
+	void place(State& s, int cell, int n) const {
+		s.grid[cell] = n;
+		s.candidates[cell] = 0;
+		for (int k = 0; k < num_peers[cell]; ++k) {
+			s.candidates[peers[cell][k]] &= ~(1 << n);
+		}
+		--s.empty;
+	}
+
+	bool propagate(State& s) const {
+		/* Place singles until stuck, return false on a contradiction */
+		for (;;) {
+			bool progress = false;
+			for (int cell = 0; cell < cells; ++cell) {
+				Mask c = s.candidates[cell];
+				if ((c & (c - 1)) == 0 and s.grid[cell] < 0) {
+					if (c == 0) {
+						return false;
+					}
+					place(s, cell, __builtin_ctz(c));
+					progress = true;
+				}
+			}
+			if (s.empty == 0) {
+				return true;
+			}
+			for (int u = 0; u < num_units; ++u) {
+				// Digits that are candidates in exactly one cell of the unit
+				Mask once = 0, twice = 0, placed = 0;
+				for (int cell : cells_of[u]) {
+					Mask c = s.candidates[cell];
+					twice |= once & c;
+					once |= c;
+					if (s.grid[cell] >= 0) {
+						placed |= 1 << s.grid[cell];
+					}
+				}
+				if ((once | placed) != all) {
+					return false;
+				}
+				for (Mask hidden = once & ~twice; hidden; hidden &= hidden - 1) {
+					int n = __builtin_ctz(hidden);
+					int k = 0;
+					while (k < sz and not (s.candidates[cells_of[u][k]] & (1 << n))) {
+						++k;
+					}
+					if (k == sz) {
+						return false;
+					}
+					place(s, cells_of[u][k], n);
+					progress = true;
+				}
+			}
+			if (not progress and not locked_candidates(s)) {
+				return true;
+			}
+		}
+	}
+
+	bool locked_candidates(State& s) const {
+		/*
+		 *  Digits that can only go in the cells a block shares with a line
+		 *  are removed from the rest of the line, and the other way round.
+		 *  Returns whether any candidates were removed.
+		 */
+		bool progress = false;
+		for (const Segment& seg : segments) {
+			Mask shared = 0, block = 0, line = 0;
+			for (int k = 0; k < seg.num_shared; ++k) {
+				shared |= s.candidates[seg.shared[k]];
+			}
+			for (int k = 0; k < seg.num_block; ++k) {
+				block |= s.candidates[seg.block[k]];
+			}
+			for (int k = 0; k < seg.num_line; ++k) {
+				line |= s.candidates[seg.line[k]];
+			}
+			if (Mask remove = shared & ~block & line) {
+				for (int k = 0; k < seg.num_line; ++k) {
+					s.candidates[seg.line[k]] &= ~remove;
+				}
+				progress = true;
+			}
+			if (Mask remove = shared & ~line & block) {
+				for (int k = 0; k < seg.num_block; ++k) {
+					s.candidates[seg.block[k]] &= ~remove;
+				}
+				progress = true;
+			}
+		}
+		return progress;
+	}
+
+	int fewest_candidates(const State& s) const {
+		int ret = -1, best = sz + 1;
+		for (int cell = 0; cell < cells and best > 2; ++cell) {
+			if (s.grid[cell] < 0) {
+				int count = __builtin_popcount(s.candidates[cell]);
+				if (count < best) {
+					ret = cell;
+					best = count;
+				}
+			}
+		}
+		return ret;
+	}
+
+	int cells_of[num_units][sz];
+	int peers[cells][max_peers];
+	int num_peers[cells];
+	Segment segments[num_segments];
+	std::vector<Level> stack;
+};
+
+namespace {
+
+template<int sz>
+inline std::string solve_clues(SparseMatrix& M, const std::string& puzzle) {
+	/* Solve a puzzle on a full puzzle_matrix */
+	auto clues = remove_clues<sz>(M, puzzle);
+	std::string ret = format_solution<sz>(M.solve());
+	replace_clues(M, clues);
+	return ret;
+}
+
+template<int sz, bool use_cross_rule>
+inline std::function<std::string(const std::string&)> puzzle_solver(Engine engine) {
+	/* Solver for a series of puzzles, keeping its matrix or board */
+	if (engine == Engine::bitboard) {
+		auto B = std::make_shared<Bitboard<sz, use_cross_rule>>();
+		return [B](const std::string& puzzle) { return B->solve(puzzle); };
+	}
+	auto M = std::make_shared<SparseMatrix>(puzzle_matrix<sz, use_cross_rule>());
+	if (engine == Engine::cells) {
+		// The rows contradicting the clues are removed from the engine
+		// itself, which is built once from the full matrix
+		auto C = std::make_shared<DancingCells>(*M);
+		return [M, C](const std::string& puzzle) {
+			auto clues = clue_rows<sz>(*M, puzzle);
+			for (const HeadNode* row : clues) {
+				C->remove_row(row);
+			}
+			std::string ret = format_solution<sz>(C->solve());
+			for (auto it = clues.rbegin(); it != clues.rend(); ++it) {
+				C->replace_row(*it);
+			}
+			return ret;
+		};
+	}
+	return [M](const std::string& puzzle) { return solve_clues<sz>(*M, puzzle); };
+}
+
+struct Batch {
+	size_t seq;
+	std::vector<std::string> puzzles;
+};
+
+}
+
+template<int sz, bool use_cross_rule = false>
+inline int solve_file(std::istream& infile, std::ostream& outfile,
+                      Engine engine = Engine::dlx) {
 	/* Faster than the basic solve routine for multiple puzzles */
 	const int sz2 = sz * sz;
-	SparseMatrix M(sz2 * sz, sz2 * (use_cross_rule ? 6 : 4),
-	               constraints_matrix<sz>);
+	auto solve_puzzle = puzzle_solver<sz, use_cross_rule>(engine);
 	int line_count = 0;
 	for (std::string puzzle; std::getline(infile, puzzle);) {
-	    std::vector<HeadNode*> clues;
 		if (puzzle.size() != sz2) {
 			continue;
 		}
 		++line_count;
-		// Get clues
-		for (int i = 0; i < sz2; ++i) {
-			int c = get_num(puzzle[i]);
-			if (is_clue<sz>(c)) {
-				for (int num = 0; num < sz; ++num) {
-					if (c != num) {
-						clues.push_back(M.rows[sz * i + num]);
-					}
-				}
+		outfile << solve_puzzle(puzzle) << '\n';
+	}
+	return line_count;
+}
+
+template<int sz, bool use_cross_rule = false>
+inline int solve_file(std::istream& infile, std::ostream& outfile,
+                      std::ostream& stats_out) {
+	/* 
+	 *  As solve_file, also writing the search statistics of each puzzle as
+	 *  a line of JSON, followed by a line with the totals for the file.
+	 */
+	const int sz2 = sz * sz;
+	SparseMatrix M = puzzle_matrix<sz, use_cross_rule>();
+	SearchStats total;
+	int line_count = 0;
+	for (std::string puzzle; std::getline(infile, puzzle);) {
+		if (puzzle.size() != sz2) {
+			continue;
+		}
+		M.stats = SearchStats();
+		outfile << solve_clues<sz>(M, puzzle) << '\n';
+		stats_out << "{\"puzzle\":" << line_count++
+		          << ",\"stats\":" << M.stats.to_json() << "}\n";
+		total.merge(M.stats);
+	}
+	stats_out << "{\"total\":" << total.to_json() << "}\n";
+	return line_count;
+}
+
+template<int sz, bool use_cross_rule = false>
+inline int solve_file(std::istream& infile, std::ostream& outfile,
+                      unsigned num_threads, Engine engine = Engine::dlx) {
+	/* 
+	 *  Pipelined version of solve_file. A reader thread splits the input
+	 *  into batches, num_threads workers solve them on their own matrices
+	 *  and the calling thread writes the solutions back in input order.
+	 *  The reader stays within a window of batches of the next one to be
+	 *  written, so a slow batch holds back at most that many others.
+	 */
+	const int sz2 = sz * sz;
+	const size_t batch_size = 256;
+	num_threads = std::max(num_threads, 1u);
+	const size_t window = 4 * num_threads;
+	BoundedQueue<Batch> input(2 * num_threads), output(2 * num_threads);
+	int line_count = 0;
+	std::mutex mutex;
+	std::condition_variable progress;
+	size_t written = 0;                  // Batches written out, under mutex
+	auto wait_for_window = [&](size_t seq) {
+		std::unique_lock<std::mutex> lock(mutex);
+		progress.wait(lock, [&] { return seq < written + window; });
+	};
+
+	std::thread reader([&] {
+		Batch batch{0, {}};
+		for (std::string puzzle; std::getline(infile, puzzle);) {
+			if (puzzle.size() != sz2) {
+				continue;
+			}
+			++line_count;
+			batch.puzzles.push_back(std::move(puzzle));
+			if (batch.puzzles.size() == batch_size) {
+				size_t next = batch.seq + 1;
+				wait_for_window(batch.seq);
+				input.push(std::move(batch));
+				batch = Batch{next, {}};
 			}
 		}
-		// Remove rows corresponding to clues
-		for (auto it = clues.begin(); it != clues.end(); ++it) {
-			M.remove_row(*it);
+		if (not batch.puzzles.empty()) {
+			wait_for_window(batch.seq);
+			input.push(std::move(batch));
 		}
-		outfile << format_solution<sz>(M.solve()) << '\n';
-		// Replace removed rows in reverse order
-		for (auto it = clues.rbegin(); it != clues.rend(); ++it) {
-			M.replace_row(*it);
+		input.close();
+	});
+
+	std::atomic<unsigned> running(num_threads);
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < num_threads; ++t) {
+		workers.emplace_back([&] {
+			auto solve_puzzle = puzzle_solver<sz, use_cross_rule>(engine);
+			for (Batch batch; input.pop(batch);) {
+				for (std::string& puzzle : batch.puzzles) {
+					puzzle = solve_puzzle(puzzle);
+				}
+				output.push(std::move(batch));
+			}
+			if (--running == 0) {
+				output.close();
+			}
+		});
+	}
+
+	// Batches may finish out of order, hold them back until their turn
+	std::map<size_t, std::vector<std::string>> finished;
+	size_t next = 0;
+	for (Batch batch; output.pop(batch);) {
+		finished.emplace(batch.seq, std::move(batch.puzzles));
+		for (auto it = finished.begin();
+		     it != finished.end() and it->first == next;
+		     it = finished.erase(it), ++next) {
+			for (const std::string& solution : it->second) {
+				outfile << solution << '\n';
+			}
 		}
+		std::lock_guard<std::mutex> lock(mutex);
+		written = next;
+		progress.notify_one();
+	}
+	reader.join();
+	for (std::thread& worker : workers) {
+		worker.join();
 	}
 	return line_count;
 }
 
+/*
+ *  Solver for a stream of requests, kept running so that each matrix is
+ *  built once rather than for every puzzle. A request is a line holding a
+ *  puzzle of 36 or 81 characters, each '.' or a digit from 1 to the size
+ *  of the grid, after "x " to use the cross rule. It is answered by a line
+ *  with the solution, "none" if there is none or "error" if the request is
+ *  malformed. Answers come in the order of the requests, so a client may
+ *  send any number before reading them. The solver of each variant is
+ *  made on first use and kept, the clues of each puzzle being removed
+ *  from its matrix and replaced afterwards.
+ */
+
+class Server {
+public:
+	explicit Server(Engine engine_ = Engine::dlx)
+	: engine(engine_)
+	, solvers() {
+	}
+
+	std::string answer(std::string request) {
+		if (not request.empty() and request.back() == '\r') {
+			request.pop_back();
+		}
+		bool cross = request.compare(0, 2, "x ") == 0;
+		if (cross) {
+			request.erase(0, 2);
+		}
+		int variant = cross;
+		if (request.size() == 81) {
+			variant += 2;
+		} else if (request.size() != 36) {
+			return "error";
+		}
+		// Only blanks and the digits of the grid size
+		const int sz = variant < 2 ? 6 : 9;
+		for (char c : request) {
+			if (c != '.' and (get_num(c) < 0 or get_num(c) >= sz)) {
+				return "error";
+			}
+		}
+		if (not solvers[variant]) {
+			solvers[variant] = make_solver(variant);
+		}
+		std::string ret = solvers[variant](request);
+		return ret.empty() ? "none" : ret;
+	}
+
+	size_t serve(std::istream& in, std::ostream& out) {
+		/*
+		 *  Answer requests until the end of the input, returning how many
+		 *  there were. Answers are flushed once the requests read so far
+		 *  are used up, so those sent together are answered together.
+		 */
+		size_t count = 0;
+		for (std::string request; std::getline(in, request); ++count) {
+			out << answer(std::move(request)) << '\n';
+			if (in.rdbuf()->in_avail() <= 0) {
+				out.flush();
+			}
+		}
+		out.flush();
+		return count;
+	}
+
+private:
+	Engine engine;
+	std::function<std::string(const std::string&)> solvers[4];
+
+	std::function<std::string(const std::string&)> make_solver(int variant) const {
+		switch (variant) {
+		  case 0: return puzzle_solver<6, false>(engine);
+		  case 1: return puzzle_solver<6, true>(engine);
+		  case 2: return puzzle_solver<9, false>(engine);
+		  default: return puzzle_solver<9, true>(engine);
+		}
+	}
+};
+
+/*
+ *  Servers shared by concurrent sessions, such as the connections to a
+ *  socket. Each session borrows an idle server, or a new one if there is
+ *  none, and gives it back at the end, so its matrices outlive the session.
+ */
+
+class ServerPool {
+public:
+	explicit ServerPool(Engine engine_ = Engine::dlx)
+	: engine(engine_)
+	, mutex()
+	, idle() {
+	}
+
+	size_t serve(std::istream& in, std::ostream& out) {
+		std::unique_ptr<Server> server;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (not idle.empty()) {
+				server = std::move(idle.back());
+				idle.pop_back();
+			}
+		}
+		if (not server) {
+			server.reset(new Server(engine));
+		}
+		size_t ret = server->serve(in, out);
+		std::lock_guard<std::mutex> lock(mutex);
+		idle.push_back(std::move(server));
+		return ret;
+	}
+
+	size_t idle_servers() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return idle.size();
+	}
+
+private:
+	Engine engine;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Server>> idle;
+};
+
 } // namespace sudoku
 
 #endif
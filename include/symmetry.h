@@ -0,0 +1,42 @@
+#ifndef _symmetry_h_
+#define _symmetry_h_
+
+#include "matrix.h"
+
+#include <cstdlib>
+#include <vector>
+
+/*
+ *  Symmetry breaking for exact cover problems that are unchanged by a group
+ *  of column permutations, such as the rotations and reflections of a
+ *  board. The group acts on the rows as well, and maps solutions to
+ *  solutions. reduce picks a primary column fixed by the whole group and
+ *  covered exactly once, and removes every row covering it except one from
+ *  each orbit of such rows, so each orbit of solutions is found at least
+ *  once and usually exactly once. expand maps a solution found after
+ *  reducing back to all its images.
+ */
+
+class Symmetry {
+public:
+    // Each permutation maps column j to perm[j]. The group must be closed
+    // and include the identity, and the set of rows of m must be mapped to
+    // itself by every permutation. Rows must cover distinct sets of
+    // columns. A list that is not a permutation of the columns, or one
+    // mapping a row to columns no row covers, throws std::invalid_argument.
+    Symmetry(SparseMatrix& m_, const std::vector<std::vector<size_t>>& perms);
+
+    size_t order() const { return row_perms.size(); }
+    size_t column() const { return col; }
+
+    std::vector<const HeadNode*> reduce();
+    std::vector<std::vector<HeadNode*>> expand(const std::vector<HeadNode*>& solution) const;
+
+private:
+    SparseMatrix& m;
+    std::vector<std::vector<size_t>> row_perms;
+    size_t col;                        // Column whose rows are reduced
+    std::vector<size_t> removable;     // Rows in col but not orbit minimal
+};
+
+#endif
@@ -3,6 +3,23 @@
 
 #include "matrix.h"
 
+#include <cstdlib>
+#include <map>
+#include <tuple>
+#include <vector>
+
+/*
+ *  Incremental timetabling. Every class type is given a number of
+ *  placements, one unless changed with require, from those offered with
+ *  add. Each placement is a row covering the column of its type and the
+ *  room and hour slots it occupies. The slots are secondary columns, so
+ *  each holds at most one class. Withdrawing a placement and offering it
+ *  again removes and replaces its row, so an edit takes time proportional
+ *  to the rows it touches instead of a rebuild. solve keeps the placements
+ *  of the previous timetable that are still offered and searches only for
+ *  the rest, starting from scratch only if they cannot be completed.
+ */
+
 struct Class {
     int type;   // 0 = empty
     int room;   // < num_rooms
@@ -10,15 +27,41 @@ struct Class {
     int length; // < 24
 };
 
-struct TimeTable {
-    TimeTable(int num_rooms) 
-      : m(num_rooms * 24) {
-        for (int i = 0; i < num_rooms * 24; ++i) {
-            m.create_row            
-        }
-    }
+class TimeTable {
+public:
+    static constexpr int hours = 24;
+
+    TimeTable(int num_rooms_, int num_types_);
+
+    // Give type between lo and hi placements, where 1 <= hi
+    void require(int type, size_t lo, size_t hi);
 
+    // Offer a placement and return its id. Offering a placement again,
+    // whether or not it was withdrawn, returns the same id.
+    size_t add(const Class& c);
+    void withdraw(size_t id);
+    bool offered(size_t id) const;
+    const Class& placement(size_t id) const { return placements[id]; }
+    size_t size() const { return placements.size(); }
+
+    // Find a timetable for the placements now offered, returning false and
+    // leaving the timetable empty if there is none
+    bool solve();
+    const std::vector<size_t>& timetable() const { return current; }
+
+private:
+    int num_rooms, num_types;
     SparseMatrix m;
+    std::vector<Class> placements;     // Indexed by id, which is the row
+    std::map<std::tuple<int, int, int, int>, size_t> ids;
+    std::vector<size_t> withdrawn;     // In the order their rows were removed
+    std::vector<size_t> current;
+
+    void restore(size_t id);
+    bool available(size_t id) const;
+    void fix(size_t id);
+    void unfix(size_t id);
+    bool complete(std::vector<size_t>& solution);
 };
 
 #endif
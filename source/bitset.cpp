@@ -0,0 +1,365 @@
+#include "bitset.h"
+#include "search.h"
+
+#include <cassert>
+
+#if defined(__x86_64__) and (defined(__GNUC__) or defined(__clang__))
+#define BITSET_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+constexpr size_t BitsetSolver::max_width;
+
+namespace {
+
+template<size_t W>
+size_t filter_scalar(const uint64_t *src, const Link *ids, size_t n,
+                     const uint64_t *row, uint64_t *dst, Link *dst_ids) {
+    /* Copy the rows disjoint from row to dst, which has room for one more.
+     * Every row is copied and only kept if disjoint, to avoid branching. */
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i, src += W) {
+        uint64_t common = 0;
+        for (size_t k = 0; k < W; ++k) {
+            common |= src[k] & row[k];
+            dst[out * W + k] = src[k];
+        }
+        dst_ids[out] = ids[i];
+        out += common == 0;
+    }
+    return out;
+}
+
+#ifdef BITSET_AVX2
+template<size_t W>
+__attribute__((target("avx2")))
+size_t filter_avx2(const uint64_t *src, const Link *ids, size_t n,
+                   const uint64_t *row, uint64_t *dst, Link *dst_ids) {
+    /* As filter_scalar, testing a group of rows that fill a vector, or a
+     * row that fills one or two, at a time */
+    constexpr size_t group = W < 4 ? 4 / W : 1;
+    constexpr size_t vecs = W < 4 ? 1 : W / 4;
+    constexpr unsigned full = (1u << W) - 1;
+    __m256i pattern[vecs];
+    for (size_t v = 0; v < vecs; ++v) {
+        pattern[v] = _mm256_setr_epi64x(row[4 * v % W], row[(4 * v + 1) % W],
+                                        row[(4 * v + 2) % W],
+                                        row[(4 * v + 3) % W]);
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    size_t out = 0, i = 0;
+    for (; i + group <= n; i += group) {
+        unsigned disjoint = 0;
+        for (size_t v = 0; v < vecs; ++v) {
+            __m256i x = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i * W + 4 * v));
+            __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(x, pattern[v]), zero);
+            disjoint |= unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(eq)))
+                        << (4 * v);
+        }
+        for (size_t r = 0; r < group; ++r) {
+            for (size_t k = 0; k < W; ++k) {
+                dst[out * W + k] = src[(i + r) * W + k];
+            }
+            dst_ids[out] = ids[i + r];
+            out += ((disjoint >> (r * W)) & full) == full;
+        }
+    }
+    return out + filter_scalar<W>(src + i * W, ids + i, n - i, row,
+                                  dst + out * W, dst_ids + out);
+}
+#endif
+
+bool cpu_has_avx2() {
+#ifdef BITSET_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+}
+
+bool BitsetSolver::suits(const SparseMatrix& m) {
+    return m.cols.size() - 1 <= max_width and m.colors.empty() and
+           m.bounds.empty();
+}
+
+BitsetSolver::BitsetSolver(SparseMatrix& m, bool simd)
+: stats()
+, rows(m.rows.data())
+, row_index()
+, words(1)
+, use_avx2(simd and cpu_has_avx2())
+, levels()
+, slices()
+, chosen() {
+    assert(suits(m));
+    Link width = m.cols.size() - 1;
+    Link num_primary = m.first_secondary - 1;
+    while (64 * words < width) {
+        words *= 2;
+    }
+    levels.resize(num_primary + 1);
+    Level& all = levels[0];
+    for (Link r = 0; r < m.rows.size(); ++r) {
+        Link first = m.rows[r].first;
+        if (m.nodes[m.nodes[first].above].below != first) {
+            continue;                  // Removed from the matrix
+        }
+        row_index.push_back(r);
+        all.ids.push_back(row_index.size() - 1);
+        all.bits.resize(all.bits.size() + words, 0);
+        uint64_t *bits = &all.bits[all.bits.size() - words];
+        for (Link x = first; m.nodes[x].top > 0; ++x) {
+            Link col = m.nodes[x].top - 1;
+            bits[col / 64] |= uint64_t(1) << (col % 64);
+        }
+    }
+    all.size = all.ids.size();
+    // Room for the row filtering writes past the last one it keeps
+    all.bits.resize(all.bits.size() + words, 0);
+    all.ids.push_back(0);
+    all.uncovered.assign(words, 0);
+    for (Link col = 0; col < num_primary; ++col) {
+        all.uncovered[col / 64] |= uint64_t(1) << (col % 64);
+    }
+    for (Level& level : levels) {
+        level.uncovered.resize(words);
+    }
+}
+
+template<size_t W>
+Link BitsetSolver::choose_col(const Level& level, size_t& count) {
+    /* The leftmost uncovered primary column with the fewest rows, which are
+     * counted into bit slices: bit k of slice s is bit s of the count of
+     * column 64 * word + k. The candidates are narrowed from the highest
+     * slice down to those with a zero bit wherever any has one. */
+    size_t height = 4;
+    while ((size_t(1) << height) <= level.size) {
+        ++height;
+    }
+    slices.assign(height * W, 0);
+    uint64_t *ones = &slices[0], *twos = &slices[W], *fours = &slices[2 * W];
+    auto add = [](uint64_t& sum, uint64_t& carry, uint64_t a, uint64_t b) {
+        uint64_t u = sum ^ a;
+        carry = (sum & a) | (u & b);
+        sum = u ^ b;
+    };
+    // Eight rows at a time with carry-save adders, as in Harley and Seal's
+    // population count, carrying into the higher slices once per group
+    const uint64_t *bits = level.bits.data();
+    size_t i = 0;
+    for (; i + 8 <= level.size; i += 8, bits += 8 * W) {
+        for (size_t k = 0; k < W; ++k) {
+            uint64_t twos_a, twos_b, fours_a, fours_b, eights;
+            add(ones[k], twos_a, bits[k], bits[W + k]);
+            add(ones[k], twos_b, bits[2 * W + k], bits[3 * W + k]);
+            add(twos[k], fours_a, twos_a, twos_b);
+            add(ones[k], twos_a, bits[4 * W + k], bits[5 * W + k]);
+            add(ones[k], twos_b, bits[6 * W + k], bits[7 * W + k]);
+            add(twos[k], fours_b, twos_a, twos_b);
+            add(fours[k], eights, fours_a, fours_b);
+            for (uint64_t *s = &slices[3 * W + k]; eights != 0; s += W) {
+                uint64_t next = *s & eights;
+                *s ^= eights;
+                eights = next;
+            }
+        }
+    }
+    for (; i < level.size; ++i, bits += W) {
+        for (size_t k = 0; k < W; ++k) {
+            uint64_t carry = bits[k];
+            for (uint64_t *s = &slices[k]; carry != 0; s += W) {
+                uint64_t next = *s & carry;
+                *s ^= carry;
+                carry = next;
+            }
+        }
+    }
+    uint64_t candidates[W];
+    for (size_t k = 0; k < W; ++k) {
+        candidates[k] = level.uncovered[k];
+    }
+    for (size_t s = height; s-- > 0;) {
+        uint64_t zero[W], any = 0;
+        for (size_t k = 0; k < W; ++k) {
+            zero[k] = candidates[k] & ~slices[s * W + k];
+            any |= zero[k];
+        }
+        if (any != 0) {
+            for (size_t k = 0; k < W; ++k) {
+                candidates[k] = zero[k];
+            }
+        }
+    }
+    size_t word = 0;
+    while (candidates[word] == 0) {
+        ++word;
+    }
+    Link col = 64 * word + __builtin_ctzll(candidates[word]);
+    count = 0;
+    for (size_t s = 0; s < height; ++s) {
+        count |= ((slices[s * W + word] >> (col % 64)) & 1) << s;
+    }
+    return col;
+}
+
+template<size_t W>
+size_t BitsetSolver::filter(const Level& level, size_t i, Level& next) {
+    /* Fill next with the rows of level compatible with row i */
+    const uint64_t *row = &level.bits[i * W];
+    if (next.ids.size() < level.size + 1) {
+        next.bits.resize((level.size + 1) * W);
+        next.ids.resize(level.size + 1);
+    }
+#ifdef BITSET_AVX2
+    if (use_avx2) {
+        next.size = filter_avx2<W>(level.bits.data(), level.ids.data(),
+                                   level.size, row, next.bits.data(),
+                                   next.ids.data());
+    } else
+#endif
+    next.size = filter_scalar<W>(level.bits.data(), level.ids.data(),
+                                 level.size, row, next.bits.data(),
+                                 next.ids.data());
+    for (size_t k = 0; k < W; ++k) {
+        next.uncovered[k] = level.uncovered[k] & ~row[k];
+    }
+    DLX_COUNT(stats.updates += level.size - next.size);
+    return next.size;
+}
+
+template<size_t W, typename Visit>
+bool BitsetSolver::search(Visit& visit) {
+    /* Call visit with each solution until it returns false, and return
+     * whether it did not */
+    size_t depth = chosen.size();
+    const Level& level = levels[depth];
+    uint64_t left = 0;
+    for (size_t k = 0; k < W; ++k) {
+        left |= level.uncovered[k];
+    }
+    if (left == 0) {
+        DLX_COUNT(++stats.solutions);
+        return visit();
+    }
+    DLX_COUNT(stats.count_node(depth));
+    size_t count;
+    Link col = choose_col<W>(level, count);
+    if (count == 0) {
+        DLX_COUNT(++stats.dead_ends);
+        return true;
+    }
+    DLX_COUNT(stats.branches += count);
+    const uint64_t bit = uint64_t(1) << (col % 64);
+    const uint64_t *word = &level.bits[col / 64];
+    bool more = true;
+    for (size_t i = 0; more and count > 0; ++i) {
+        if (word[i * W] & bit) {
+            --count;
+            filter<W>(level, i, levels[depth + 1]);
+            chosen.push_back(level.ids[i]);
+            more = search<W>(visit);
+            chosen.pop_back();
+        }
+    }
+    return more;
+}
+
+template<typename Visit>
+void BitsetSolver::run(Visit& visit) {
+    switch (words) {
+      case 1:
+        search<1>(visit);
+        break;
+      case 2:
+        search<2>(visit);
+        break;
+      case 4:
+        search<4>(visit);
+        break;
+      default:
+        search<8>(visit);
+        break;
+    }
+}
+
+vector<HeadNode*> BitsetSolver::solution() const {
+    vector<HeadNode*> ret;
+    for (Link id : chosen) {
+        ret.push_back(rows + row_index[id]);
+    }
+    return ret;
+}
+
+vector<HeadNode*> BitsetSolver::solve() {
+    /* Find a single solution to the exact cover problem. */
+    vector<HeadNode*> ret;
+    auto visit = [&] {
+        ret = solution();
+        return false;
+    };
+    run(visit);
+    return ret;
+}
+
+vector<vector<HeadNode*>> BitsetSolver::solve_all() {
+    /* Find all solutions to the exact cover problem. */
+    vector<vector<HeadNode*>> ret;
+    auto visit = [&] {
+        ret.push_back(solution());
+        return true;
+    };
+    run(visit);
+    return ret;
+}
+
+vector<vector<HeadNode*>> BitsetSolver::solve_up_to(size_t k) {
+    /* Find at most k solutions, stopping the search once k are found. */
+    vector<vector<HeadNode*>> ret;
+    if (k == 0) {
+        return ret;
+    }
+    auto visit = [&] {
+        ret.push_back(solution());
+        return ret.size() < k;
+    };
+    run(visit);
+    return ret;
+}
+
+size_t BitsetSolver::count_up_to(size_t k) {
+    /* Count solutions, stopping once k are found. */
+    size_t ret = 0;
+    if (k == 0) {
+        return ret;
+    }
+    auto visit = [&] {
+        return ++ret < k;
+    };
+    run(visit);
+    return ret;
+}
+
+void BitsetSolver::for_each(const function<bool(const vector<HeadNode*>&)>& visit) {
+    auto each = [&] {
+        return visit(solution());
+    };
+    run(each);
+}
+
+void for_each_solution(SparseMatrix& m,
+                       const function<bool(const vector<HeadNode*>&)>& visit) {
+    if (BitsetSolver::suits(m)) {
+        BitsetSolver(m).for_each(visit);
+        return;
+    }
+    for (const auto& solution : m.solutions()) {
+        if (not visit(solution)) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,260 @@
+#include "cells.h"
+
+#include <cassert>
+
+using namespace std;
+
+DancingCells::DancingCells(SparseMatrix& m)
+: stats()
+, rows(m.rows.data())
+, row_index()
+, option_of(m.rows.size(), 0)
+, cells()
+, set()
+, blocks()
+, items()
+, item_pos()
+, num_primary(m.first_secondary - 1)
+, active(num_primary)
+, chosen() {
+    assert(m.colors.empty() and m.bounds.empty());
+    Link width = m.cols.size() - 1;
+    blocks.assign(width, Block{0, 0});
+    cells.reserve(m.nodes.size() - width);
+    for (Link r = 0; r < m.rows.size(); ++r) {
+        Link first = m.rows[r].first;
+        if (m.nodes[m.nodes[first].above].below != first) {
+            continue;                  // Removed from the matrix
+        }
+        cells.push_back({-int32_t(row_index.size() + 1), 0});
+        option_of[r] = cells.size();
+        row_index.push_back(r);
+        for (Link x = first; m.nodes[x].top > 0; ++x) {
+            Link item = m.nodes[x].top - 1;
+            cells.push_back({int32_t(item), 0});
+            ++blocks[item].size;
+        }
+    }
+    cells.push_back({-int32_t(row_index.size() + 1), 0});
+
+    // The options of each item in row order
+    vector<Link> fill(width, 0);
+    for (Link i = 1; i < width; ++i) {
+        fill[i] = blocks[i].start = blocks[i - 1].start + blocks[i - 1].size;
+    }
+    set.resize(cells.size() - row_index.size() - 1);
+    for (Link x = 0; x < cells.size(); ++x) {
+        if (cells[x].item >= 0) {
+            cells[x].loc = fill[cells[x].item]++;
+            set[cells[x].loc] = x;
+        }
+    }
+    for (Link i = 0; i < num_primary; ++i) {
+        items.push_back(i);
+        item_pos.push_back(i);
+    }
+}
+
+Link DancingCells::choose_item() const {
+    /* The active primary item with the fewest options, first on ties */
+    Link ret = items[0];
+    for (Link k = 1; k < active; ++k) {
+        Link i = items[k];
+        Link n = blocks[i].size, best = blocks[ret].size;
+        if (n < best or (n == best and i < ret)) {
+            ret = i;
+        }
+    }
+    return ret;
+}
+
+inline void DancingCells::remove(Link y) {
+    /* Swap node y with the last active entry of its item's set, which then
+     * ends just before it */
+    Block& b = blocks[cells[y].item];
+    Link last = b.start + --b.size;
+    Link loc = cells[y].loc;
+    if (loc != last) {
+        Link z = set[last];
+        set[loc] = z;
+        cells[z].loc = loc;
+        set[last] = y;
+        cells[y].loc = last;
+    }
+    DLX_COUNT(++stats.updates);
+}
+
+void DancingCells::hide(Link x) {
+    /* Remove the option of node x from the sets of its other items. Nodes
+     * after x are visited first, then those before it. */
+    for (Link y = x + 1; cells[y].item >= 0; ++y) {
+        remove(y);
+    }
+    for (Link y = x - 1; cells[y].item >= 0; --y) {
+        remove(y);
+    }
+}
+
+void DancingCells::unhide(Link x) {
+    /* The items of an option are distinct, so any order will do */
+    for (Link y = x + 1; cells[y].item >= 0; ++y) {
+        ++blocks[cells[y].item].size;
+    }
+    for (Link y = x - 1; cells[y].item >= 0; --y) {
+        ++blocks[cells[y].item].size;
+    }
+}
+
+void DancingCells::remove_row(const HeadNode* row) {
+    Link x = option_of[row - rows];
+    assert(x > 0);
+    remove(x);
+    hide(x);
+}
+
+void DancingCells::replace_row(const HeadNode* row) {
+    Link x = option_of[row - rows];
+    unhide(x);
+    ++blocks[cells[x].item].size;
+}
+
+void DancingCells::cover(Link item) {
+    /* Deactivate an item and hide all its options */
+    if (item < num_primary) {
+        Link p = item_pos[item], other = items[--active];
+        items[p] = other;
+        item_pos[other] = p;
+        items[active] = item;
+        item_pos[item] = active;
+    }
+    const Block& b = blocks[item];
+    for (Link k = b.start; k < b.start + b.size; ++k) {
+        hide(set[k]);
+    }
+}
+
+void DancingCells::uncover(Link item) {
+    const Block& b = blocks[item];
+    for (Link k = b.start + b.size; k-- > b.start;) {
+        unhide(set[k]);
+    }
+    if (item < num_primary) {
+        ++active;
+    }
+}
+
+void DancingCells::choose(Link x) {
+    /* Cover the other items of the option of node x */
+    for (Link y = x + 1; cells[y].item >= 0; ++y) {
+        cover(cells[y].item);
+    }
+    for (Link y = x - 1; cells[y].item >= 0; --y) {
+        cover(cells[y].item);
+    }
+}
+
+void DancingCells::unchoose(Link x) {
+    Link y = x - 1;
+    while (cells[y].item >= 0) {
+        --y;
+    }
+    while (++y != x) {
+        uncover(cells[y].item);
+    }
+    while (cells[y + 1].item >= 0) {
+        ++y;
+    }
+    for (; y != x; --y) {
+        uncover(cells[y].item);
+    }
+}
+
+template<typename Visit>
+bool DancingCells::search(Visit& visit) {
+    /* Call visit with each solution until it returns false, and return
+     * whether it did not */
+    if (active == 0) {
+        DLX_COUNT(++stats.solutions);
+        return visit();
+    }
+    DLX_COUNT(stats.count_node(chosen.size()));
+    Link item = choose_item();
+    const Block& b = blocks[item];
+    if (b.size == 0) {
+        DLX_COUNT(++stats.dead_ends);
+        return true;
+    }
+    DLX_COUNT(stats.branches += b.size);
+    cover(item);
+    bool more = true;
+    for (Link k = b.start; more and k < b.start + b.size; ++k) {
+        Link x = set[k];
+        choose(x);
+        chosen.push_back(x);
+        more = search(visit);
+        chosen.pop_back();
+        unchoose(x);
+    }
+    uncover(item);
+    return more;
+}
+
+vector<HeadNode*> DancingCells::solution() const {
+    vector<HeadNode*> ret;
+    for (Link x : chosen) {
+        while (cells[x].item >= 0) {
+            --x;
+        }
+        ret.push_back(rows + row_index[-cells[x].item - 1]);
+    }
+    return ret;
+}
+
+vector<HeadNode*> DancingCells::solve() {
+    /* Find a single solution to the exact cover problem. */
+    vector<HeadNode*> ret;
+    auto visit = [&] {
+        ret = solution();
+        return false;
+    };
+    search(visit);
+    return ret;
+}
+
+vector<vector<HeadNode*>> DancingCells::solve_all() {
+    /* Find all solutions to the exact cover problem. */
+    vector<vector<HeadNode*>> ret;
+    auto visit = [&] {
+        ret.push_back(solution());
+        return true;
+    };
+    search(visit);
+    return ret;
+}
+
+vector<vector<HeadNode*>> DancingCells::solve_up_to(size_t k) {
+    /* Find at most k solutions, stopping the search once k are found. */
+    vector<vector<HeadNode*>> ret;
+    if (k == 0) {
+        return ret;
+    }
+    auto visit = [&] {
+        ret.push_back(solution());
+        return ret.size() < k;
+    };
+    search(visit);
+    return ret;
+}
+
+size_t DancingCells::count_up_to(size_t k) {
+    /* Count solutions, stopping once k are found. */
+    size_t ret = 0;
+    if (k == 0) {
+        return ret;
+    }
+    auto visit = [&] {
+        return ++ret < k;
+    };
+    search(visit);
+    return ret;
+}
@@ -1,144 +1,567 @@
 #include "matrix.h"
+#include "search.h"
+
+#include <algorithm>
 
 using namespace std;
 
+constexpr Link SparseMatrix::root;
+constexpr Link SparseMatrix::bucket_limit;
+constexpr size_t SparseMatrix::scan_limit;
+constexpr size_t SparseMatrix::limit_interval;
+
 SparseMatrix::SparseMatrix(size_t width)
-: head(new HeadNode())
-, cols(width)
-, rows() {
+: SparseMatrix(width, 0) {
+}
+
+SparseMatrix::SparseMatrix(size_t primary, size_t secondary)
+: nodes(primary + secondary + 2)
+, cols(primary + secondary + 1)
+, rows()
+, first_secondary(primary + 1)
+, colors()
+, bounds()
+, slacks()
+, upper()
+, policy(ColumnPolicy::min_size)
+, rng()
+, stats()
+, link_updates(0)
+, bucket_bits()
+, bucket_sizes()
+, bucket_words(0)
+, bucket_min(0)
+, tweaked() {
     /* Create matrix with no rows */
-    for (size_t j = 0; j < width; ++j) {
-        cols[j] = make_unique<HeadNode>(head.get());
-    }
+    reset();
+    nodes[cols.size()] = {0, 0, 0};  // Spacer before the first row
 }
 
 SparseMatrix::SparseMatrix(size_t height, size_t width,
                            function<bool (size_t, size_t)> pred)
-: head(new HeadNode())
-, cols(width)
-, rows(height) {
-    // Setup col headers
-    for (size_t j = 0; j < width; ++j) {
-        cols[j] = make_unique<HeadNode>(head.get());
-    }
-    // Fill in rows 
+: SparseMatrix(width) {
+    reserve(height, 0);
     for (size_t i = 0; i < height; ++i) {
-        rows[i] = new HeadNode(head.get(), i);
+        begin_row(i);
         for (size_t j = 0; j < width; ++j) {
             if (pred(j, i)) {
-                new Node(cols[j].get(), rows[i]);
+                append_node(j + 1);
             }
         }
+        end_row();
     }
 }
 
 void SparseMatrix::create_row(size_t data, const std::set<int>& col_nums) {
     /* Add new row to matrix with given columns. */
-    HeadNode *row = new HeadNode(head.get(), data);
-    rows.push_back(row);
-    for (int col_num : col_nums) {
-        new Node(cols[col_num].get(), row);
+    add_row(data, col_nums);
+}
+
+void SparseMatrix::reserve(size_t height, size_t nonzeros) {
+    /* Make room for height more rows with nonzeros nodes between them */
+    rows.reserve(rows.size() + height);
+    nodes.reserve(nodes.size() + nonzeros + height);
+}
+
+void SparseMatrix::reset() {
+    /* Relink the nodes of each column in row order */
+    Link width = cols.size() - 1;
+    Link last = first_secondary - 1;   // Last primary column
+    for (Link j = 0; j <= width; ++j) {
+        nodes[j] = {j, j, 0};
+        if (j > last) {
+            cols[j] = {j, j};          // Secondary, never in the list
+        } else {
+            cols[j] = {j == root ? last : j - 1,
+                       j == last ? root : j + 1};
+        }
     }
+    for (Link x = width + 2; x < nodes.size(); ++x) {
+        if (not colors.empty() and colors[x] < 0) {
+            colors[x] = colors[nodes[x].top];
+        }
+        int32_t col = nodes[x].top;
+        if (col > 0) {
+            nodes[x].above = nodes[col].above;
+            nodes[x].below = col;
+            nodes[nodes[col].above].below = x;
+            nodes[col].above = x;
+            ++nodes[col].top;
+        }
+    }
+    bucket_sizes.clear();
+    bounds = upper;
+    tweaked.clear();
 }
 
-void SparseMatrix::remove_col_and_rows(HeadNode *col) {
+void SparseMatrix::set_multiplicity(size_t col_num, size_t lo, size_t hi) {
+    /* Require column col_num to be covered by between lo and hi rows */
+    if (upper.empty()) {
+        upper.assign(cols.size(), 1);
+        slacks.assign(cols.size(), 0);
+    }
+    upper[col_num + 1] = hi;
+    slacks[col_num + 1] = hi - lo;
+    bounds = upper;
+    bucket_sizes.clear();            // The size index ignores bounds
+}
+
+void SparseMatrix::begin_row(size_t data) {
+    bucket_sizes.clear();            // Rebuilt with the new sizes
+    rows.push_back({data, Link(nodes.size())});
+}
+
+void SparseMatrix::append_node(Link col) {
+    /* Add a node to the end of the current row and the bottom of col */
+    Link x = nodes.size();
+    nodes.push_back({nodes[col].above, col, int32_t(col)});
+    if (not colors.empty()) {
+        colors.push_back(0);
+    }
+    nodes[nodes[col].above].below = x;
+    nodes[col].above = x;
+    ++nodes[col].top;
+}
+
+void SparseMatrix::end_row() {
+    Link first = rows.back().first;
+    nodes[first - 1].below = nodes.size() - 1;
+    nodes.push_back({first, 0, -int32_t(rows.size())});
+    if (not colors.empty()) {
+        colors.push_back(0);
+    }
+}
+
+void SparseMatrix::build_buckets() {
+    bucket_words = cols.size() / 64 + 1;
+    bucket_bits.assign((bucket_limit + 1) * bucket_words, 0);
+    bucket_sizes.assign(bucket_limit + 1, 0);
+    bucket_min = bucket_limit + 1;
+    for (Link c = cols[root].right; c != root; c = cols[c].right) {
+        bucket_insert(c, nodes[c].top);
+    }
+}
+
+inline void SparseMatrix::bucket_insert(Link col, Link size) {
+    if (size <= bucket_limit) {
+        bucket_bits[size * bucket_words + col / 64] |= uint64_t(1) << (col % 64);
+        ++bucket_sizes[size];
+        bucket_min = min(bucket_min, size);
+    }
+}
+
+inline void SparseMatrix::bucket_erase(Link col, Link size) {
+    if (size <= bucket_limit) {
+        bucket_bits[size * bucket_words + col / 64] &= ~(uint64_t(1) << (col % 64));
+        --bucket_sizes[size];
+    }
+}
+
+template<bool bucketed>
+inline void SparseMatrix::hide_node(Link x) {
+    Node& n = nodes[x];
+    nodes[n.above].below = n.below;
+    nodes[n.below].above = n.above;
+    DLX_COUNT(++stats.updates);
+    Link size = nodes[n.top].top--;
+    if (bucketed and Link(n.top) < first_secondary) {
+        bucket_erase(n.top, size);
+        bucket_insert(n.top, size - 1);
+    }
+}
+
+template<bool bucketed>
+inline void SparseMatrix::unhide_node(Link x) {
+    Node& n = nodes[x];
+    nodes[n.above].below = x;
+    nodes[n.below].above = x;
+    DLX_COUNT(++stats.updates);
+    Link size = nodes[n.top].top++;
+    if (bucketed and Link(n.top) < first_secondary) {
+        bucket_erase(n.top, size);
+        bucket_insert(n.top, size + 1);
+    }
+}
+
+template<bool bucketed, bool colored>
+inline Link SparseMatrix::hide_others(Link i) {
+/* Remove the nodes of the row containing i other than i from their columns,
+ * leaving those already known to have the right color, and return how many
+ * were removed. Callers add the counts to link_updates, once per column
+ * in hide_rows, which is cheaper than once per node. */
+    Link count = 0;
+    for (Link j = i + 1; j != i;) {
+        if (nodes[j].top <= 0) {
+            j = nodes[j].above;
+        } else if (colored and colors[j] < 0) {
+            ++j;
+        } else {
+            hide_node<bucketed>(j++);
+            ++count;
+        }
+    }
+    return count;
+}
+
+template<bool bucketed, bool colored>
+inline Link SparseMatrix::unhide_others(Link i) {
+    Link count = 0;
+    for (Link j = i - 1; j != i;) {
+        if (nodes[j].top <= 0) {
+            j = nodes[j].below;
+        } else if (colored and colors[j] < 0) {
+            --j;
+        } else {
+            unhide_node<bucketed>(j--);
+            ++count;
+        }
+    }
+    return count;
+}
+
+template<bool bucketed, bool colored>
+inline void SparseMatrix::hide_rows(Link col) {
+    uint64_t count = 0;
+    for (Link i = nodes[col].below; i != col; i = nodes[i].below) {
+        count += hide_others<bucketed, colored>(i);
+    }
+    link_updates += count;
+}
+
+template<bool bucketed, bool colored>
+inline void SparseMatrix::unhide_rows(Link col) {
+    uint64_t count = 0;
+    for (Link i = nodes[col].above; i != col; i = nodes[i].above) {
+        count += unhide_others<bucketed, colored>(i);
+    }
+    link_updates += count;
+}
+
+void SparseMatrix::remove_from_col(Link x) {
+    ++link_updates;
+    if (bucket_sizes.empty()) {
+        hide_node<false>(x);
+    } else {
+        hide_node<true>(x);
+    }
+}
+
+void SparseMatrix::replace_in_col(Link x) {
+    ++link_updates;
+    if (bucket_sizes.empty()) {
+        unhide_node<false>(x);
+    } else {
+        unhide_node<true>(x);
+    }
+}
+
+void SparseMatrix::remove_col_and_rows(Link col) {
 /* Remove a column and all rows it has a 1 in */
-    col->remove_from_row();
-    for (Node *i = col->below; i != col; i = i->below) {
-        for (Node *j = i->right; j != i; j = j->right) {
-             j->remove_from_col();
+    cols[cols[col].left].right = cols[col].right;
+    cols[cols[col].right].left = cols[col].left;
+    if (bucket_sizes.empty()) {
+        if (colors.empty()) {
+            hide_rows<false, false>(col);
+        } else {
+            hide_rows<false, true>(col);
+        }
+    } else {
+        if (col < first_secondary) {
+            bucket_erase(col, nodes[col].top);
+        }
+        if (colors.empty()) {
+            hide_rows<true, false>(col);
+        } else {
+            hide_rows<true, true>(col);
         }
     }
 }
 
-void SparseMatrix::replace_col_and_rows(HeadNode *col) {
+void SparseMatrix::replace_col_and_rows(Link col) {
 /* Replace a column and all rows it has a 1 in */
-    for (Node *i = col->above; i != col; i = i->above) {
-        for (Node *j = i->left; j != i; j = j->left) {
-           j->replace_in_col();
+    if (bucket_sizes.empty()) {
+        if (colors.empty()) {
+            unhide_rows<false, false>(col);
+        } else {
+            unhide_rows<false, true>(col);
+        }
+    } else {
+        if (colors.empty()) {
+            unhide_rows<true, false>(col);
+        } else {
+            unhide_rows<true, true>(col);
         }
+        if (col < first_secondary) {
+            bucket_insert(col, nodes[col].top);
+        }
+    }
+    cols[cols[col].left].right = col;
+    cols[cols[col].right].left = col;
+}
+
+void SparseMatrix::remove_row(const HeadNode *row) {
+    for (Link j = row->first; nodes[j].top > 0; ++j) {
+       remove_from_col(j);
     }
-    col->replace_in_row();
 }
 
-void SparseMatrix::remove_row(Node *i) {
-    for (Node *j = i->right; j != i; j = j->right) {
-       j->remove_from_col();
+void SparseMatrix::replace_row(const HeadNode *row) {
+    Link j = row->first;
+    while (nodes[j].top > 0) {
+        ++j;
+    }
+    while (j-- != row->first) {
+       replace_in_col(j);
     }
 }
-        
-void SparseMatrix::replace_row(Node *i) {
-    for (Node *j = i->left; j != i; j = j->left) {
-       j->replace_in_col();
+
+Link SparseMatrix::choose_col() {
+/* Return the column to branch on next, according to policy */
+    switch (policy) {
+      case ColumnPolicy::first:
+        return cols[root].right;
+      case ColumnPolicy::random_min:
+        return random_min_col();
+      default:
+        return min_col();
     }
 }
 
-HeadNode* SparseMatrix::min_col() const {
-/* Return the column header with the smallest data entry */
-    HeadNode* ret = head->right->col;
-    size_t result, min = ret->data;
-    for (Node* col = head->right; col != head.get(); col = col->right) {
-        result = col->col->data;
-        if (result < min) {
-            ret = col->col;
-            min = result;
+Link SparseMatrix::min_col() {
+/* Return the leftmost column header with the fewest nodes */
+    if (bucket_sizes.empty() and cols.size() > scan_limit and bounds.empty()) {
+        build_buckets();
+    }
+    if (not bucket_sizes.empty()) {
+        while (bucket_min <= bucket_limit and bucket_sizes[bucket_min] == 0) {
+            ++bucket_min;
+        }
+    }
+    if (not bucket_sizes.empty() and bucket_min <= bucket_limit) {
+        const uint64_t *bits = &bucket_bits[bucket_min * bucket_words];
+        for (size_t w = 0;; ++w) {
+            if (bits[w] != 0) {
+                return w * 64 + __builtin_ctzll(bits[w]);
+            }
+        }
+    }
+    // Narrow matrix, or every column is too large to be bucketed, which
+    // only happens near the root of the search tree
+    Link ret = cols[root].right;
+    if (not bounds.empty()) {
+        for (Link col = cols[ret].right; col != root; col = cols[col].right) {
+            if (branches(col) < branches(ret)) {
+                ret = col;
+            }
+        }
+        return ret;
+    }
+    for (Link col = cols[ret].right; col != root; col = cols[col].right) {
+        if (nodes[col].top < nodes[ret].top) {
+            ret = col;
         }
     }
     return ret;
 }
 
-bool SparseMatrix::iterate(vector<HeadNode*>& solution) {
-    if (head->right == head.get()) {
-        return true;
-    }
-    bool result = false;
-    HeadNode* c = min_col();
-    remove_col_and_rows(c);
-    for (Node *r = c->below; r != c; r = r->below) {
-        for (Node *j = r->row->right; j != r->row; j = j->right) {
-            if (j != r) {
-                remove_col_and_rows(j->col);
+Link SparseMatrix::random_min_col() {
+/* Return a column with the fewest nodes, chosen uniformly at random */
+    Link ret = min_col();
+    if (not bucket_sizes.empty() and bucket_min <= bucket_limit) {
+        size_t k = rng() % bucket_sizes[bucket_min];
+        const uint64_t *bits = &bucket_bits[bucket_min * bucket_words];
+        for (size_t w = 0;; ++w) {
+            size_t count = __builtin_popcountll(bits[w]);
+            if (k < count) {
+                uint64_t word = bits[w];
+                for (; k > 0; --k) {
+                    word &= word - 1;
+                }
+                return w * 64 + __builtin_ctzll(word);
             }
+            k -= count;
         }
-        result = iterate(solution);
-        for (Node *j = r->row->left; j != r->row; j = j->left) {
-            if (j != r) {
-                replace_col_and_rows(j->col);
+    }
+    size_t ties = 0;
+    for (Link col = cols[root].right; col != root; col = cols[col].right) {
+        if (branches(col) == branches(ret) and rng() % ++ties == 0) {
+            ret = col;
+        }
+    }
+    return ret;
+}
+
+HeadNode *SparseMatrix::row_of(Link x) {
+/* Return the header of the row containing node x */
+    while (nodes[x].top > 0) {
+        --x;
+    }
+    return &rows[-nodes[x].top];
+}
+
+void SparseMatrix::choose_row(Link r) {
+/* Remove the other columns of the row containing r and their rows, or
+ * for a colored node the rows that disagree with its color */
+    for (Link j = r + 1; j != r;) {
+        if (nodes[j].top <= 0) {
+            j = nodes[j].above;
+        } else if (colors.empty() or colors[j] == 0) {
+            Link col = nodes[j++].top;
+            if (bounds.empty() or --bounds[col] == 0) {
+                remove_col_and_rows(col);
             }
+        } else if (colors[j] > 0) {
+            purify(j++);
+        } else {
+            ++j;
         }
-        if (result) {
-            solution.push_back(r->row);
-            break;
+    }
+}
+
+void SparseMatrix::unchoose_row(Link r) {
+/* Undo choose_row */
+    for (Link j = r - 1; j != r;) {
+        if (nodes[j].top <= 0) {
+            j = nodes[j].below;
+        } else if (colors.empty() or colors[j] == 0) {
+            Link col = nodes[j--].top;
+            if (bounds.empty() or bounds[col]++ == 0) {
+                replace_col_and_rows(col);
+            }
+        } else if (colors[j] > 0) {
+            unpurify(j--);
+        } else {
+            --j;
         }
     }
-    replace_col_and_rows(c);
-    return result;
 }
 
-void SparseMatrix::iterate_all(vector<std::vector<HeadNode*>>& solutions) {
-    static vector<HeadNode*> current_solution;
-    if (head->right == head.get()) {
-        solutions.push_back(current_solution);
-        return;
+void SparseMatrix::purify(Link p) {
+/* Remove the rows whose color in the column of p differs from that of p,
+ * and mark the others so they are left alone until unpurify */
+    int32_t c = colors[p];
+    Link col = nodes[p].top;
+    colors[col] = c;
+    for (Link q = nodes[col].below; q != col; q = nodes[q].below) {
+        if (colors[q] != c) {
+            if (bucket_sizes.empty()) {
+                link_updates += hide_others<false, true>(q);
+            } else {
+                link_updates += hide_others<true, true>(q);
+            }
+        } else if (q != p) {
+            colors[q] = -1;
+        }
     }
-    HeadNode* c = min_col();
-    remove_col_and_rows(c);
-    for (Node *r = c->below; r != c; r = r->below) {
-        for (Node *j = r->row->right; j != r->row; j = j->right) {
-            if (j != r) {
-                remove_col_and_rows(j->col);
+}
+
+void SparseMatrix::unpurify(Link p) {
+    int32_t c = colors[p];
+    Link col = nodes[p].top;
+    for (Link q = nodes[col].above; q != col; q = nodes[q].above) {
+        if (colors[q] < 0) {
+            colors[q] = c;
+        } else if (q != p) {
+            if (bucket_sizes.empty()) {
+                link_updates += unhide_others<false, true>(q);
+            } else {
+                link_updates += unhide_others<true, true>(q);
             }
         }
-        current_solution.push_back(r->row);
-        iterate_all(solutions);
-        current_solution.pop_back();
-        for (Node *j = r->row->left; j != r->row; j = j->left) {
-            if (j != r) {
-                replace_col_and_rows(j->col);
+    }
+    colors[col] = 0;
+}
+
+void SparseMatrix::enter_col(Link col) {
+/* Start branching on col, covering it if the next row to be chosen is the
+ * last it allows */
+    if (bounds.empty() or --bounds[col] == 0) {
+        remove_col_and_rows(col);
+    }
+}
+
+void SparseMatrix::leave_col(Link col, Link first) {
+/* Undo enter_col and the tweaks made since, of rows from first on */
+    if (bounds.empty() or bounds[col] == 0) {
+        replace_col_and_rows(col);
+    } else {
+        // Rows of a column are in the order of their nodes, and any rows
+        // tweaked by an enclosing level on the same column come before
+        // first. If first is the header the column was empty.
+        while (first != col and not tweaked.empty() and tweaked.back() >= first and
+               Link(nodes[tweaked.back()].top) == col) {
+            Link r = tweaked.back();
+            tweaked.pop_back();
+            if (colors.empty()) {
+                link_updates += unhide_others<false, false>(r);
+            } else {
+                link_updates += unhide_others<false, true>(r);
             }
+            unhide_node<false>(r);
+            ++link_updates;
         }
     }
-    replace_col_and_rows(c);
+    if (not bounds.empty()) {
+        ++bounds[col];
+    }
+}
+
+bool SparseMatrix::enough_rows(Link col) const {
+/* Whether the rows left in col, counting the next one to try, can still
+ * meet its lower bound */
+    return bounds.empty() or
+        nodes[col].top + std::int32_t(slacks[col]) > std::int32_t(bounds[col]);
+}
+
+void SparseMatrix::tweak_row(Link r) {
+/* Remove the row containing r before choosing it, unless the column of r
+ * is covered, so that deeper levels only choose rows after it */
+    if (bounds.empty() or bounds[nodes[r].top] == 0) {
+        return;
+    }
+    hide_node<false>(r);
+    if (colors.empty()) {
+        link_updates += hide_others<false, false>(r) + 1;
+    } else {
+        link_updates += hide_others<false, true>(r) + 1;
+    }
+    tweaked.push_back(r);
+}
+
+bool SparseMatrix::skip_col(Link col) {
+/* Choose no more rows in col, once all have been tried, if that meets its
+ * lower bound */
+    if (bounds.empty() or bounds[col] + 1 > slacks[col]) {
+        return false;
+    }
+    if (bounds[col] != 0) {
+        cols[cols[col].left].right = cols[col].right;
+        cols[cols[col].right].left = cols[col].left;
+    }
+    return true;
+}
+
+void SparseMatrix::unskip_col(Link col) {
+    if (bounds[col] != 0) {
+        cols[cols[col].left].right = col;
+        cols[cols[col].right].left = col;
+    }
+}
+
+bool SparseMatrix::iterate(vector<HeadNode*>& solution) {
+    Search search(*this);
+    if (search.step() != Search::found) {
+        return false;
+    }
+    solution = search.solution();
+    return true;
+}
+
+void SparseMatrix::iterate_all(vector<vector<HeadNode*>>& solutions) {
+    Search search(*this);
+    while (search.step() == Search::found) {
+        solutions.push_back(search.solution());
+    }
 }
 
 vector<HeadNode*> SparseMatrix::solve() {
@@ -150,7 +573,82 @@ vector<HeadNode*> SparseMatrix::solve() {
 
 vector<vector<HeadNode*>> SparseMatrix::solve_all() {
 /* Find all solutions to the exact cover problem. */
-    vector<std::vector<HeadNode*>> ret;
+    vector<vector<HeadNode*>> ret;
     iterate_all(ret);
     return ret;
 }
+
+vector<vector<HeadNode*>> SparseMatrix::solve_up_to(size_t k) {
+/* Find at most k solutions, stopping the search once k are found. */
+    vector<vector<HeadNode*>> ret;
+    Search search(*this);
+    while (ret.size() < k and search.step() == Search::found) {
+        ret.push_back(search.solution());
+    }
+    return ret;
+}
+
+size_t SparseMatrix::count_up_to(size_t k) {
+/* Count solutions, stopping once k are found. */
+    size_t ret = 0;
+    Search search(*this);
+    while (ret < k and search.step() == Search::found) {
+        ++ret;
+    }
+    return ret;
+}
+
+void SparseMatrix::iterate_limited(const Limits& limits, size_t max_solutions,
+                                   SolveResult& result) {
+/* Search until max_solutions are found, the tree is exhausted or a limit is
+ * hit. Nodes are counted by the search, so it is only ever asked for as
+ * many as are left, and the other limits are checked between its steps. */
+    using clock = chrono::steady_clock;
+    bool timed = limits.deadline != clock::time_point::max();
+    uint64_t start = link_updates, next_check = limit_interval;
+    result.solutions.clear();
+    {
+        Search search(*this);
+        for (;;) {
+            size_t left = limits.nodes - min<uint64_t>(limits.nodes, search.nodes());
+            Search::Status status = search.step(min(left, limit_interval));
+            if (status == Search::exhausted) {
+                result.status = SolveResult::exhausted;
+                break;
+            }
+            if (status == Search::found) {
+                result.solutions.push_back(search.solution());
+                if (result.solutions.size() == max_solutions) {
+                    result.status = SolveResult::solved;
+                    break;
+                }
+                if (search.nodes() < next_check) {
+                    continue;
+                }
+            }
+            next_check = search.nodes() + limit_interval;
+            if ((status == Search::paused and left <= limit_interval) or
+                link_updates - start >= limits.updates or
+                (timed and clock::now() >= limits.deadline)) {
+                result.status = SolveResult::limit_hit;
+                break;
+            }
+        }
+        result.nodes = search.nodes();
+    }
+    result.updates = link_updates - start;
+}
+
+SolveResult SparseMatrix::solve(const Limits& limits) {
+/* Find a single solution, giving up once a limit is hit. */
+    SolveResult ret;
+    iterate_limited(limits, 1, ret);
+    return ret;
+}
+
+SolveResult SparseMatrix::solve_all(const Limits& limits) {
+/* Find all solutions, or those found before a limit is hit. */
+    SolveResult ret;
+    iterate_limited(limits, -1, ret);
+    return ret;
+}
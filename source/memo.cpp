@@ -0,0 +1,259 @@
+#include "memo.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+Natural::Natural(uint64_t n)
+: limbs() {
+    for (; n != 0; n >>= 32) {
+        limbs.push_back(uint32_t(n));
+    }
+}
+
+Natural& Natural::operator+=(const Natural& other) {
+    if (limbs.size() < other.limbs.size()) {
+        limbs.resize(other.limbs.size(), 0);
+    }
+    uint64_t carry = 0;
+    for (size_t i = 0; i < limbs.size() and (carry != 0 or i < other.limbs.size()); ++i) {
+        carry += uint64_t(limbs[i]) + (i < other.limbs.size() ? other.limbs[i] : 0);
+        limbs[i] = uint32_t(carry);
+        carry >>= 32;
+    }
+    if (carry != 0) {
+        limbs.push_back(uint32_t(carry));
+    }
+    return *this;
+}
+
+string Natural::to_string() const {
+    /* Divide by a billion at a time, giving nine digits each */
+    vector<uint32_t> n = limbs;
+    string ret;
+    while (not n.empty()) {
+        uint64_t rem = 0;
+        for (size_t i = n.size(); i-- > 0;) {
+            uint64_t cur = (rem << 32) | n[i];
+            n[i] = uint32_t(cur / 1000000000);
+            rem = cur % 1000000000;
+        }
+        while (not n.empty() and n.back() == 0) {
+            n.pop_back();
+        }
+        for (int d = 0; d < 9 and (rem != 0 or not n.empty()); ++d) {
+            ret.push_back(char('0' + rem % 10));
+            rem /= 10;
+        }
+    }
+    if (ret.empty()) {
+        ret = "0";
+    }
+    reverse(ret.begin(), ret.end());
+    return ret;
+}
+
+Natural Zdd::count() const {
+    /* Children come first, so one pass from the terminals up will do */
+    vector<Natural> counts(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (i < 2) {
+            counts[i] = Natural(i);
+        } else {
+            counts[i] = counts[nodes[i].lo];
+            counts[i] += counts[nodes[i].hi];
+        }
+    }
+    return counts[root];
+}
+
+vector<vector<HeadNode*>> Zdd::solutions() const {
+    /* Follow every path to the terminal 1, taking the row of each node
+     * left by its hi edge */
+    vector<vector<HeadNode*>> ret;
+    vector<HeadNode*> current;
+    vector<pair<size_t, size_t>> stack{{root, 0}}; // Node and rows taken
+    while (not stack.empty()) {
+        size_t node = stack.back().first;
+        current.resize(stack.back().second);
+        stack.pop_back();
+        if (node == 1) {
+            ret.push_back(current);
+        } else if (node > 1) {
+            stack.emplace_back(nodes[node].lo, current.size());
+            current.push_back(rows + nodes[node].row);
+            stack.emplace_back(nodes[node].hi, current.size());
+        }
+    }
+    return ret;
+}
+
+template<typename Value>
+class MemoCounter::Memo {
+    /* Direct mapped table from sets of covered columns to results */
+public:
+    Memo(size_t bytes, size_t words_)
+    : words(words_)
+    , hashes()
+    , keys()
+    , values() {
+        size_t slots = max<size_t>(1, bytes / (words * 8 + sizeof(uint64_t) +
+                                               sizeof(Value) + 16));
+        hashes.assign(slots, 0);
+        keys.assign(slots * words, 0);
+        values.resize(slots);
+    }
+
+    bool find(const vector<uint64_t>& key, uint64_t& hash, Value& value) const {
+        hash = 1469598103934665603u;
+        for (uint64_t w : key) {
+            hash = (hash ^ w) * 1099511628211u;
+            hash ^= hash >> 29;
+        }
+        hash |= 1;                     // Zero marks an empty slot
+        size_t slot = hash % hashes.size();
+        if (hashes[slot] != hash or
+            not equal(key.begin(), key.end(), keys.begin() + slot * words)) {
+            return false;
+        }
+        value = values[slot];
+        return true;
+    }
+
+    void store(const vector<uint64_t>& key, uint64_t hash, const Value& value) {
+        size_t slot = hash % hashes.size();
+        hashes[slot] = hash;
+        copy(key.begin(), key.end(), keys.begin() + slot * words);
+        values[slot] = value;
+    }
+
+private:
+    size_t words;
+    vector<uint64_t> hashes;
+    vector<uint64_t> keys;
+    vector<Value> values;
+};
+
+MemoCounter::MemoCounter(SparseMatrix& m_, size_t memo_bytes_)
+: stats()
+, hits(0)
+, misses(0)
+, m(m_)
+, memo_bytes(memo_bytes_)
+, words((m.cols.size() + 62) / 64)
+, covered(words, 0)
+, diagram()
+, unique() {
+}
+
+void MemoCounter::cover_row(Link x, bool set) {
+    /* Mark the columns of the row containing x as covered or not */
+    for (Link j = m.row_of(x)->first; m.nodes[j].top > 0; ++j) {
+        Link col = m.nodes[j].top - 1;
+        if (set) {
+            covered[col / 64] |= uint64_t(1) << (col % 64);
+        } else {
+            covered[col / 64] &= ~(uint64_t(1) << (col % 64));
+        }
+    }
+}
+
+Natural MemoCounter::count(Memo<Natural>& memo, size_t depth) {
+    if (m.cols[SparseMatrix::root].right == SparseMatrix::root) {
+        DLX_COUNT(++stats.solutions);
+        return Natural(1);
+    }
+    uint64_t hash;
+    Natural ret;
+    if (memo.find(covered, hash, ret)) {
+        ++hits;
+        return ret;
+    }
+    ++misses;
+    DLX_COUNT(stats.count_node(depth));
+    Link col = m.choose_col();
+    if (m.nodes[col].top == 0) {
+        DLX_COUNT(++stats.dead_ends);
+    } else {
+        DLX_COUNT(stats.branches += m.nodes[col].top);
+        m.enter_col(col);
+        for (Link r = m.nodes[col].below; r != col; r = m.nodes[r].below) {
+            m.choose_row(r);
+            cover_row(r, true);
+            ret += count(memo, depth + 1);
+            cover_row(r, false);
+            m.unchoose_row(r);
+        }
+        m.leave_col(col, col);
+    }
+    memo.store(covered, hash, ret);
+    return ret;
+}
+
+size_t MemoCounter::make_node(Link row, size_t lo, size_t hi) {
+    /* The node for a row and children, shared with any equal one */
+    if (hi == 0) {
+        return lo;
+    }
+    auto it = unique.emplace(make_tuple(row, lo, hi), diagram.nodes.size());
+    if (it.second) {
+        diagram.nodes.push_back({row, lo, hi});
+    }
+    return it.first->second;
+}
+
+size_t MemoCounter::zdd(Memo<size_t>& memo, size_t depth) {
+    if (m.cols[SparseMatrix::root].right == SparseMatrix::root) {
+        DLX_COUNT(++stats.solutions);
+        return 1;
+    }
+    uint64_t hash;
+    size_t ret = 0;
+    if (memo.find(covered, hash, ret)) {
+        ++hits;
+        return ret;
+    }
+    ++misses;
+    DLX_COUNT(stats.count_node(depth));
+    Link col = m.choose_col();
+    if (m.nodes[col].top == 0) {
+        DLX_COUNT(++stats.dead_ends);
+    } else {
+        // The rows of the column are chained by their lo edges in the
+        // order they were tried
+        DLX_COUNT(stats.branches += m.nodes[col].top);
+        vector<pair<Link, size_t>> children;
+        m.enter_col(col);
+        for (Link r = m.nodes[col].below; r != col; r = m.nodes[r].below) {
+            m.choose_row(r);
+            cover_row(r, true);
+            children.emplace_back(m.row_of(r) - m.rows.data(), zdd(memo, depth + 1));
+            cover_row(r, false);
+            m.unchoose_row(r);
+        }
+        m.leave_col(col, col);
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            ret = make_node(it->first, ret, it->second);
+        }
+    }
+    memo.store(covered, hash, ret);
+    return ret;
+}
+
+Natural MemoCounter::count() {
+    /* Count the solutions of the exact cover problem. */
+    assert(m.colors.empty() and m.bounds.empty());
+    Memo<Natural> memo(memo_bytes, words);
+    return count(memo, 0);
+}
+
+Zdd MemoCounter::zdd() {
+    /* Find all solutions of the exact cover problem as a diagram. */
+    assert(m.colors.empty() and m.bounds.empty());
+    Memo<size_t> memo(memo_bytes, words);
+    diagram = Zdd{{{0, 0, 0}, {0, 1, 1}}, 0, m.rows.data()};
+    unique.clear();
+    diagram.root = zdd(memo, 0);
+    return move(diagram);
+}
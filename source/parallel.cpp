@@ -0,0 +1,319 @@
+#include "matrix.h"
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+/*
+ *  Parallel enumeration of all solutions. A subproblem is given by the
+ *  nodes of the rows chosen on the path from the root of the search tree,
+ *  and is solved by a worker on its own copy of the matrix. Workers keep
+ *  a deque of pending subproblems and steal from each other when they run
+ *  out. When any worker is idle, a busy worker splits off the untried rows
+ *  at the shallowest level of its current search.
+ */
+
+namespace {
+
+using Path = vector<Link>;
+
+struct Worker;
+
+struct Pool {
+    vector<Worker*> workers;
+    atomic<size_t> pending;          // Subproblems not yet fully explored
+    atomic<bool> hungry;             // Some worker has nothing to do
+};
+
+// Search nodes between checks for idle workers
+const size_t split_interval = 1024;
+
+struct Worker {
+    Worker(const SparseMatrix& m_, Pool& pool_)
+    : m(m_)
+    , pool(pool_) {
+        m.stats = SearchStats();
+    }
+
+    SparseMatrix m;
+    Pool& pool;
+    mutex lock;
+    deque<Path> tasks;
+
+    vector<vector<size_t>> solutions;
+
+    void push(Path task) {
+        lock_guard<mutex> guard(lock);
+        tasks.push_back(move(task));
+    }
+
+    bool pop(Path& task) {
+        lock_guard<mutex> guard(lock);
+        if (tasks.empty()) {
+            return false;
+        }
+        task = move(tasks.back());
+        tasks.pop_back();
+        return true;
+    }
+
+    bool steal(Path& task) {
+        lock_guard<mutex> guard(lock);
+        if (tasks.empty()) {
+            return false;
+        }
+        task = move(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+
+    void run() {
+        Path task;
+        for (;;) {
+            if (pop(task) or steal_any(task)) {
+                explore(task);
+                --pool.pending;
+            } else if (pool.pending == 0) {
+                return;
+            } else {
+                pool.hungry = true;
+                this_thread::yield();
+            }
+        }
+    }
+
+    bool steal_any(Path& task) {
+        for (Worker *victim : pool.workers) {
+            if (victim != this and victim->steal(task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void explore(const Path& task) {
+        for (Link r : task) {
+            m.remove_col_and_rows(m.nodes[r].top);
+            m.choose_row(r);
+        }
+        {
+            Search search(m);
+            for (;;) {
+                Search::Status status = search.step(split_interval);
+                if (status == Search::exhausted) {
+                    break;
+                }
+                if (status == Search::found) {
+                    record(task, search);
+                }
+                if (pool.hungry) {
+                    split(task, search);
+                }
+            }
+        }
+        for (auto it = task.rbegin(); it != task.rend(); ++it) {
+            m.unchoose_row(*it);
+            m.replace_col_and_rows(m.nodes[*it].top);
+        }
+    }
+
+    void split(const Path& task, Search& search) {
+        /* Give away the untried rows at the shallowest level that has any */
+        size_t level;
+        vector<Link> siblings = search.split(level);
+        if (siblings.empty()) {
+            return;
+        }
+        Path prefix = task;
+        for (size_t d = 0; d <= level; ++d) {
+            prefix.push_back(search.levels()[d].row);
+        }
+        for (Link s : siblings) {
+            prefix.back() = s;
+            ++pool.pending;
+            push(prefix);
+        }
+        pool.hungry = false;
+    }
+
+    void record(const Path& task, const Search& search) {
+        vector<size_t> solution;
+        for (Link r : task) {
+            solution.push_back(m.row_of(r) - m.rows.data());
+        }
+        for (const Search::Level& l : search.levels()) {
+            solution.push_back(m.row_of(l.row) - m.rows.data());
+        }
+        solutions.push_back(move(solution));
+    }
+};
+
+} // namespace
+
+vector<vector<HeadNode*>> SparseMatrix::solve_all(unsigned num_threads) {
+/* Find all solutions using several threads, in the same order as solve_all */
+    if (not bounds.empty()) {
+        return solve_all();          // Subproblems are only paths of rows
+    }
+    num_threads = max(num_threads, 1u);
+    Pool pool;
+    pool.pending = 1;
+    pool.hungry = false;
+    vector<unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < num_threads; ++i) {
+        workers.emplace_back(new Worker(*this, pool));
+        pool.workers.push_back(workers.back().get());
+    }
+    workers[0]->push(Path());
+    vector<thread> threads;
+    for (auto& w : workers) {
+        threads.emplace_back(&Worker::run, w.get());
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    // Rows earlier in a column list have lower indices, so ordering the
+    // solutions lexicographically by row index reproduces the serial order.
+    vector<vector<size_t>> all;
+    for (auto& w : workers) {
+        move(w->solutions.begin(), w->solutions.end(), back_inserter(all));
+        stats.merge(w->m.stats);
+    }
+    sort(all.begin(), all.end());
+    vector<vector<HeadNode*>> ret;
+    ret.reserve(all.size());
+    for (const auto& solution : all) {
+        ret.emplace_back();
+        for (size_t i : solution) {
+            ret.back().push_back(&rows[i]);
+        }
+    }
+    return ret;
+}
+
+/*
+ *  Racing differently configured searches for a single solution, to cut
+ *  the heavy tail of run times caused by unlucky column and row orders.
+ *  Each racer publishes the number of nodes it took to its first solution,
+ *  packed with its index into one shared word holding the best so far, and
+ *  checks that word every race_interval nodes. A racer gives up once it
+ *  has visited more nodes than the best, as it can no longer win, so the
+ *  winner does not depend on how the threads are scheduled. The first to
+ *  exhaust its search proves there is no solution and stops everyone.
+ */
+
+namespace {
+
+// Search nodes between checks of the best result
+const size_t race_interval = 256;
+
+struct Racer {
+    Racer(const SparseMatrix& m_, unsigned seed)
+    : m(m_)
+    , solution() {
+        m.stats = SearchStats();
+        if (seed != 0) {
+            shuffle_rows(seed);
+        }
+    }
+
+    SparseMatrix m;
+    vector<size_t> solution;
+
+    void shuffle_rows(unsigned seed) {
+        /* Relink the nodes of each column in a random order. Rows tried
+         * at a level of Algorithm M must stay in node order, so only the
+         * ties are broken at random when there are multiplicities. */
+        m.policy = ColumnPolicy::random_min;
+        m.rng.seed(seed);
+        if (not m.bounds.empty()) {
+            return;
+        }
+        vector<Link> order;
+        for (Link col = 1; col < m.cols.size(); ++col) {
+            order.clear();
+            for (Link x = m.nodes[col].below; x != col; x = m.nodes[x].below) {
+                order.push_back(x);
+            }
+            std::shuffle(order.begin(), order.end(), m.rng);
+            Link prev = col;
+            for (Link x : order) {
+                m.nodes[prev].below = x;
+                m.nodes[x].above = prev;
+                prev = x;
+            }
+            m.nodes[prev].below = col;
+            m.nodes[col].above = prev;
+        }
+    }
+
+    void run(size_t index, atomic<uint64_t>& best, atomic<bool>& none) {
+        Search search(m);
+        for (;;) {
+            Search::Status status = search.step(race_interval);
+            uint64_t mine = uint64_t(search.nodes()) << 16 | index;
+            if (status == Search::found) {
+                for (uint64_t b = best; mine < b and
+                     not best.compare_exchange_weak(b, mine);) {
+                }
+                for (const Search::Level& l : search.levels()) {
+                    if (l.row != l.col) {
+                        solution.push_back(m.row_of(l.row) - m.rows.data());
+                    }
+                }
+                return;
+            }
+            if (status == Search::exhausted) {
+                none = true;
+                return;
+            }
+            if (mine > best or none) {
+                return;
+            }
+        }
+    }
+};
+
+} // namespace
+
+vector<HeadNode*> SparseMatrix::solve_race(const vector<unsigned>& seeds) {
+/* Find a single solution with a portfolio of searches, one per seed */
+    // The winner is packed into the low 16 bits of best
+    if (seeds.empty() or seeds.size() >= (1u << 16)) {
+        throw invalid_argument("solve_race: needs between 1 and 65535 seeds");
+    }
+    atomic<uint64_t> best(uint64_t(-1));
+    atomic<bool> none(false);
+    vector<unique_ptr<Racer>> racers;
+    for (unsigned seed : seeds) {
+        racers.emplace_back(new Racer(*this, seed));
+    }
+    vector<thread> threads;
+    for (size_t i = 0; i < racers.size(); ++i) {
+        threads.emplace_back(&Racer::run, racers[i].get(), i, ref(best), ref(none));
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    for (auto& r : racers) {
+        stats.merge(r->m.stats);
+    }
+
+    vector<HeadNode*> ret;
+    if (not none) {
+        for (size_t i : racers[best & 0xffff]->solution) {
+            ret.push_back(&rows[i]);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,219 @@
+#include "polyomino.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+using namespace std;
+
+namespace polyomino {
+
+namespace {
+
+Cell transform(Cell c, int rotation, bool reflect) {
+    if (reflect) {
+        c.x = -c.x;
+    }
+    for (int r = 0; r < rotation; ++r) {
+        c = {c.y, -c.x};
+    }
+    return c;
+}
+
+vector<Cell> read_drawing(const vector<string>& drawing) {
+    vector<Cell> ret;
+    for (size_t y = 0; y < drawing.size(); ++y) {
+        for (size_t x = 0; x < drawing[y].size(); ++x) {
+            if (drawing[y][x] == '#') {
+                ret.push_back({int(x), int(y)});
+            }
+        }
+    }
+    return ret;
+}
+
+vector<pair<int, int>> normalise(vector<Cell> cells) {
+/* Cells moved to touch the axes, in reading order, to compare shapes */
+    int min_x = cells[0].x, min_y = cells[0].y;
+    for (Cell c : cells) {
+        min_x = min(min_x, c.x);
+        min_y = min(min_y, c.y);
+    }
+    vector<pair<int, int>> ret;
+    for (Cell c : cells) {
+        ret.emplace_back(c.y - min_y, c.x - min_x);
+    }
+    sort(ret.begin(), ret.end());
+    return ret;
+}
+
+}
+
+Piece::Piece(char name_, const vector<string>& drawing, size_t count_)
+: name(name_)
+, cells(read_drawing(drawing))
+, count(count_) {
+}
+
+Tiling::Tiling(const vector<string>& board, const vector<Piece>& pieces_,
+               bool reflections_)
+: pieces(pieces_)
+, reflections(reflections_)
+, piece_cols()
+, squares()
+, square_at()
+, board_x(0)
+, board_y(board.size())
+, rows() {
+    for (const string& line : board) {
+        board_x = max(board_x, int(line.size()));
+    }
+    square_at.assign(board_x * board_y, -1);
+    for (Cell c : read_drawing(board)) {
+        square_at[c.x + c.y * board_x] = squares.size();
+        squares.push_back(c);
+    }
+    piece_cols.push_back(0);
+    for (const Piece& p : pieces) {
+        // A piece with no copies to place has no column
+        piece_cols.push_back(piece_cols.back() + (p.count > 0));
+    }
+
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        if (pieces[i].cells.empty() or pieces[i].count == 0) {
+            continue;
+        }
+        // Distinct orientations, each with its first square in reading
+        // order at the origin
+        set<vector<pair<int, int>>> orientations;
+        for (bool reflect : {false, true}) {
+            for (int rotation = 0; rotation < 4; ++rotation) {
+                vector<Cell> cells;
+                for (Cell c : pieces[i].cells) {
+                    cells.push_back(transform(c, rotation, reflect));
+                }
+                orientations.insert(normalise(cells));
+            }
+            if (not reflections) {
+                break;
+            }
+        }
+        for (const auto& shape : orientations) {
+            for (Cell origin : squares) {
+                Placement p{i, {}};
+                for (const auto& yx : shape) {
+                    int s = find_square({origin.x + yx.second - shape[0].second,
+                                         origin.y + yx.first - shape[0].first});
+                    if (s < 0) {
+                        break;
+                    }
+                    p.squares.push_back(s);
+                }
+                if (p.squares.size() == shape.size()) {
+                    sort(p.squares.begin(), p.squares.end());
+                    rows.push_back(move(p));
+                }
+            }
+        }
+    }
+}
+
+int Tiling::find_square(Cell c) const {
+    if (c.x < 0 or c.x >= board_x or c.y < 0 or c.y >= board_y) {
+        return -1;
+    }
+    return square_at[c.x + c.y * board_x];
+}
+
+size_t Tiling::nonzeros() const {
+    size_t ret = 0;
+    for (const Placement& p : rows) {
+        ret += p.squares.size() + 1;
+    }
+    return ret;
+}
+
+double Tiling::density() const {
+    return height() == 0 ? 0.0 : double(nonzeros()) / (double(height()) * width());
+}
+
+void Tiling::report(ostream& os) const {
+    size_t copies = 0;
+    for (const Piece& p : pieces) {
+        copies += p.count;
+    }
+    os << squares.size() << " squares, " << copies << " pieces, "
+       << rows.size() << " placements\n"
+       << "Matrix of " << height() << " rows, " << width() << " columns and "
+       << nonzeros() << " nodes, density " << density() << '\n';
+}
+
+SparseMatrix Tiling::matrix() const {
+    SparseMatrix ret(width());
+    ret.reserve(height(), nonzeros());
+    vector<size_t> cols;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        cols.assign(1, piece_cols[rows[i].piece]);
+        for (size_t s : rows[i].squares) {
+            cols.push_back(piece_cols.back() + s);
+        }
+        ret.add_row(i, cols);
+    }
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        if (pieces[i].count > 1) {
+            ret.set_multiplicity(piece_cols[i], pieces[i].count, pieces[i].count);
+        }
+    }
+    return ret;
+}
+
+string Tiling::format(const vector<HeadNode*>& solution) const {
+/* The board with each square labelled by the piece covering it */
+    string ret;
+    for (int y = 0; y < board_y; ++y) {
+        ret.append(board_x, ' ');
+        ret.push_back('\n');
+    }
+    for (const HeadNode *n : solution) {
+        const Placement& p = rows[n->data];
+        for (size_t s : p.squares) {
+            ret[squares[s].x + squares[s].y * (board_x + 1)] = pieces[p.piece].name;
+        }
+    }
+    return ret;
+}
+
+vector<vector<size_t>> Tiling::symmetries() const {
+    vector<vector<size_t>> ret;
+    for (bool reflect : {false, true}) {
+        if (reflect and not reflections) {
+            break;
+        }
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            vector<size_t> perm(width());
+            for (size_t j = 0; j < piece_cols.back(); ++j) {
+                perm[j] = j;
+            }
+            bool symmetric = true;
+            for (size_t s = 0; s < squares.size() and symmetric; ++s) {
+                // Transform about the centre of the board
+                Cell c = transform({2 * squares[s].x - board_x + 1,
+                                    2 * squares[s].y - board_y + 1},
+                                   rotation, reflect);
+                c = {c.x + board_x - 1, c.y + board_y - 1};
+                int image = -1;
+                if (c.x % 2 == 0 and c.y % 2 == 0) {
+                    image = find_square({c.x / 2, c.y / 2});
+                }
+                symmetric = image >= 0;
+                perm[piece_cols.back() + s] = piece_cols.back() + image;
+            }
+            if (symmetric) {
+                ret.push_back(perm);
+            }
+        }
+    }
+    return ret;
+}
+
+} // namespace polyomino
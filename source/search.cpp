@@ -0,0 +1,141 @@
+#include "search.h"
+
+using namespace std;
+
+Search::Search(SparseMatrix& m_)
+: m(m_)
+, stack()
+, state(enter)
+, node_count(0) {
+    stack.reserve(m.cols.size());
+}
+
+Search::~Search() {
+    abort();
+}
+
+Search::Status Search::step(size_t max_nodes) {
+/* Run until a solution is found, the search ends or max_nodes are visited */
+    size_t budget = max_nodes;
+    for (;;) {
+        switch (state) {
+          case enter:
+            if (m.cols[SparseMatrix::root].right == SparseMatrix::root) {
+                DLX_COUNT(++m.stats.solutions);
+                state = backtrack;
+                return found;
+            }
+            if (budget == 0) {
+                return paused;
+            }
+            --budget;
+            ++node_count;
+            DLX_COUNT(m.stats.count_node(stack.size()));
+            {
+                Link c = m.choose_col();
+                if (m.branches(c) <= 0) {
+                    DLX_COUNT(++m.stats.dead_ends);
+                    state = backtrack;
+                    break;
+                }
+                DLX_COUNT(m.stats.branches += m.branches(c));
+                m.enter_col(c);
+                stack.push_back({c, m.nodes[c].below, c, m.nodes[c].below});
+            }
+            state = next_row;
+            break;
+          case next_row:
+            {
+                Level& l = stack.back();
+                if (l.row != l.end and m.enough_rows(l.col)) {
+                    m.tweak_row(l.row);
+                    m.choose_row(l.row);
+                    state = enter;
+                } else if (l.row == l.col and m.skip_col(l.col)) {
+                    state = enter;
+                } else {
+                    m.leave_col(l.col, l.first);
+                    stack.pop_back();
+                    state = backtrack;
+                }
+            }
+            break;
+          case backtrack:
+            if (stack.empty()) {
+                state = done;
+                return exhausted;
+            }
+            if (stack.back().row == stack.back().col) {
+                // Skipped the column, and all its rows were tried before
+                m.unskip_col(stack.back().col);
+                m.leave_col(stack.back().col, stack.back().first);
+                stack.pop_back();
+                break;
+            }
+            m.unchoose_row(stack.back().row);
+            stack.back().row = m.nodes[stack.back().row].below;
+            state = next_row;
+            break;
+          case done:
+            return exhausted;
+        }
+    }
+}
+
+void Search::abort() {
+/* Give up the search and restore the matrix */
+    bool chosen = (state == enter or state == backtrack);
+    while (not stack.empty()) {
+        if (chosen and stack.back().row == stack.back().col) {
+            m.unskip_col(stack.back().col);
+        } else if (chosen) {
+            m.unchoose_row(stack.back().row);
+        }
+        m.leave_col(stack.back().col, stack.back().first);
+        stack.pop_back();
+        chosen = true;
+    }
+    state = done;
+}
+
+vector<HeadNode*> Search::solution() const {
+    vector<HeadNode*> ret;
+    solution(ret);
+    return ret;
+}
+
+void Search::solution(vector<HeadNode*>& out) const {
+    out.clear();
+    for (const Level& l : stack) {
+        if (l.row != l.col) {
+            out.push_back(m.row_of(l.row));
+        }
+    }
+}
+
+vector<Link> Search::split(size_t& level) {
+    vector<Link> ret;
+    if (not m.bounds.empty()) {
+        return ret;                  // Rows left at a level depend on the ones tried
+    }
+    for (level = 0; level < stack.size(); ++level) {
+        Level& l = stack[level];
+        if (l.row == l.end) {
+            continue;
+        }
+        Link next = m.nodes[l.row].below;
+        for (Link r = next; r != l.end; r = m.nodes[r].below) {
+            ret.push_back(r);
+        }
+        if (not ret.empty()) {
+            l.end = next;
+            return ret;
+        }
+    }
+    return ret;
+}
+
+Solutions SparseMatrix::solutions() {
+/* Lazily find all solutions to the exact cover problem. */
+    return Solutions(*this);
+}
@@ -0,0 +1,132 @@
+#include "socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+bool unix_address(const string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+}
+
+SocketBuf::SocketBuf(int fd_)
+: fd(fd_) {
+    setg(in, in, in);
+    setp(out, out + sizeof(out));
+}
+
+SocketBuf::~SocketBuf() {
+    sync();
+    close(fd);
+}
+
+int SocketBuf::underflow() {
+    ssize_t n;
+    do {
+        n = recv(fd, in, sizeof(in), 0);
+    } while (n < 0 and errno == EINTR);
+    if (n <= 0) {
+        return traits_type::eof();
+    }
+    setg(in, in, in + n);
+    return traits_type::to_int_type(*gptr());
+}
+
+int SocketBuf::overflow(int c) {
+    if (sync() != 0) {
+        return traits_type::eof();
+    }
+    if (not traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int SocketBuf::sync() {
+    for (char *p = pbase(); p < pptr();) {
+        // No SIGPIPE if the peer has gone, the write just fails
+        ssize_t n = send(fd, p, pptr() - p, MSG_NOSIGNAL);
+        if (n < 0 and errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return -1;
+        }
+        p += n;
+    }
+    setp(out, out + sizeof(out));
+    return 0;
+}
+
+int listen_unix_socket(const string& path) {
+    sockaddr_un addr;
+    if (not unix_address(path, addr)) {
+        return -1;
+    }
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or
+        listen(fd, SOMAXCONN) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+int connect_unix_socket(const string& path) {
+    sockaddr_un addr;
+    if (not unix_address(path, addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+void serve_connections(int listener,
+                       function<void(istream&, ostream&)> session) {
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR or errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        thread([session, fd] {
+            SocketBuf buf(fd);
+            istream in(&buf);
+            ostream out(&buf);
+            session(in, out);
+        }).detach();
+    }
+}
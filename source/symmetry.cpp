@@ -0,0 +1,124 @@
+#include "symmetry.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+
+Symmetry::Symmetry(SparseMatrix& m_, const vector<vector<size_t>>& perms)
+: m(m_)
+, row_perms()
+, col(-1)
+, removable() {
+    size_t width = m.cols.size() - 1;
+    vector<vector<size_t>> row_cols(m.rows.size());
+    vector<vector<size_t>> col_rows(width);
+    map<vector<size_t>, size_t> index;
+    for (size_t r = 0; r < m.rows.size(); ++r) {
+        for (Link x = m.rows[r].first; m.nodes[x].top > 0; ++x) {
+            row_cols[r].push_back(m.nodes[x].top - 1);
+            col_rows[m.nodes[x].top - 1].push_back(r);
+        }
+        sort(row_cols[r].begin(), row_cols[r].end());
+        if (not index.emplace(row_cols[r], r).second) {
+            throw invalid_argument("Symmetry: two rows cover the same columns");
+        }
+    }
+
+    // Permutation of the rows given by each permutation of the columns
+    for (const vector<size_t>& perm : perms) {
+        if (perm.size() != width) {
+            throw invalid_argument("Symmetry: permutation of the wrong width");
+        }
+        vector<bool> hit(width, false);
+        for (size_t j : perm) {
+            if (j >= width or hit[j]) {
+                throw invalid_argument("Symmetry: not a permutation of the columns");
+            }
+            hit[j] = true;
+        }
+        vector<size_t> row_perm(m.rows.size());
+        for (size_t r = 0; r < m.rows.size(); ++r) {
+            vector<size_t> image;
+            for (size_t j : row_cols[r]) {
+                image.push_back(perm[j]);
+            }
+            sort(image.begin(), image.end());
+            auto it = index.find(image);
+            if (it == index.end()) {
+                throw invalid_argument("Symmetry: permutation maps a row "
+                                       "outside the matrix");
+            }
+            row_perm[r] = it->second;
+        }
+        row_perms.push_back(move(row_perm));
+    }
+
+    // Reduce the fixed column with the most rows per orbit, among the
+    // primary columns covered exactly once, as every solution then uses a
+    // single row of it
+    size_t best_rows = 1, best_orbits = 1;
+    for (size_t j = 0; j < width; ++j) {
+        bool fixed = all_of(perms.begin(), perms.end(),
+                            [j](const vector<size_t>& perm) { return perm[j] == j; });
+        bool exactly_once = j + 1 < m.first_secondary and
+            (m.upper.empty() or (m.upper[j + 1] == 1 and m.slacks[j + 1] == 0));
+        if (not fixed or not exactly_once) {
+            continue;
+        }
+        size_t orbits = 0;
+        for (size_t r : col_rows[j]) {
+            bool minimal = all_of(row_perms.begin(), row_perms.end(),
+                                  [r](const vector<size_t>& p) { return p[r] >= r; });
+            orbits += minimal;
+        }
+        if (orbits > 0 and col_rows[j].size() * best_orbits > best_rows * orbits) {
+            col = j;
+            best_rows = col_rows[j].size();
+            best_orbits = orbits;
+        }
+    }
+    if (col < width) {
+        for (size_t r : col_rows[col]) {
+            for (const vector<size_t>& p : row_perms) {
+                if (p[r] < r) {
+                    removable.push_back(r);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+vector<const HeadNode*> Symmetry::reduce() {
+/* Remove all but the first row of each orbit from column(). Replacing the
+ * returned rows in reverse order undoes this. */
+    vector<const HeadNode*> ret;
+    for (size_t r : removable) {
+        ret.push_back(&m.rows[r]);
+        m.remove_row(ret.back());
+    }
+    return ret;
+}
+
+vector<vector<HeadNode*>> Symmetry::expand(const vector<HeadNode*>& solution) const {
+/* Distinct images of a solution under the group */
+    vector<vector<HeadNode*>> ret;
+    set<vector<size_t>> seen;
+    for (const vector<size_t>& p : row_perms) {
+        vector<size_t> image;
+        for (const HeadNode *n : solution) {
+            image.push_back(p[n - m.rows.data()]);
+        }
+        sort(image.begin(), image.end());
+        if (seen.insert(image).second) {
+            ret.emplace_back();
+            for (size_t r : image) {
+                ret.back().push_back(&m.rows[r]);
+            }
+        }
+    }
+    return ret;
+}
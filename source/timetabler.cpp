@@ -0,0 +1,147 @@
+#include "timetabler.h"
+#include "search.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+constexpr int TimeTable::hours;
+
+TimeTable::TimeTable(int num_rooms_, int num_types_)
+: num_rooms(num_rooms_)
+, num_types(num_types_)
+, m(num_types_, num_rooms_ * hours)
+, placements()
+, ids()
+, withdrawn()
+, current() {
+}
+
+void TimeTable::require(int type, size_t lo, size_t hi) {
+    assert(type > 0 and type <= num_types);
+    m.set_multiplicity(type - 1, lo, hi);
+}
+
+size_t TimeTable::add(const Class& c) {
+    /* Offer a placement, adding its row unless it was offered before */
+    assert(c.type > 0 and c.type <= num_types);
+    assert(c.room >= 0 and c.room < num_rooms);
+    assert(c.time >= 0 and c.length > 0 and c.time + c.length <= hours);
+    auto key = make_tuple(c.type, c.room, c.time, c.length);
+    auto it = ids.find(key);
+    if (it != ids.end()) {
+        if (not offered(it->second)) {
+            restore(it->second);
+        }
+        return it->second;
+    }
+
+    // New nodes go at the bottom of each column, so the withdrawn rows are
+    // put back first and every row is removed again in the same order
+    for (auto w = withdrawn.rbegin(); w != withdrawn.rend(); ++w) {
+        m.replace_row(&m.rows[*w]);
+    }
+    vector<size_t> cols{size_t(c.type - 1)};
+    for (int h = c.time; h < c.time + c.length; ++h) {
+        cols.push_back(num_types + c.room * hours + h);
+    }
+    size_t id = placements.size();
+    m.add_row(id, cols);
+    for (size_t w : withdrawn) {
+        m.remove_row(&m.rows[w]);
+    }
+    placements.push_back(c);
+    ids.emplace(key, id);
+    return id;
+}
+
+void TimeTable::withdraw(size_t id) {
+    if (offered(id)) {
+        m.remove_row(&m.rows[id]);
+        withdrawn.push_back(id);
+    }
+}
+
+bool TimeTable::offered(size_t id) const {
+    return find(withdrawn.begin(), withdrawn.end(), id) == withdrawn.end();
+}
+
+void TimeTable::restore(size_t id) {
+    /* Replace the row of a withdrawn placement. Rows are replaced in the
+     * reverse of the order they were removed in, so those removed after it
+     * are replaced first and removed again. */
+    auto pos = find(withdrawn.begin(), withdrawn.end(), id);
+    for (auto w = withdrawn.rbegin(); w.base() != pos; ++w) {
+        m.replace_row(&m.rows[*w]);
+    }
+    pos = withdrawn.erase(pos);
+    for (auto w = pos; w != withdrawn.end(); ++w) {
+        m.remove_row(&m.rows[*w]);
+    }
+}
+
+bool TimeTable::available(size_t id) const {
+    /* Whether every node of the row is still linked into its column */
+    for (Link x = m.rows[id].first; m.nodes[x].top > 0; ++x) {
+        if (m.nodes[m.nodes[x].above].below != x) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TimeTable::fix(size_t id) {
+    /* Choose a row outside the search. Its first node is in the column of
+     * its type, which is covered if this uses up the type. */
+    Link x = m.rows[id].first;
+    m.remove_row(&m.rows[id]);
+    m.enter_col(m.nodes[x].top);
+    m.choose_row(x);
+}
+
+void TimeTable::unfix(size_t id) {
+    Link x = m.rows[id].first;
+    Link col = m.nodes[x].top;
+    m.unchoose_row(x);
+    m.leave_col(col, col);
+    m.replace_row(&m.rows[id]);
+}
+
+bool TimeTable::complete(vector<size_t>& solution) {
+    /* Add the rows of the first solution of the matrix as it stands */
+    Search search(m);
+    if (search.step() != Search::found) {
+        return false;
+    }
+    for (HeadNode *row : search.solution()) {
+        solution.push_back(row->data);
+    }
+    return true;
+}
+
+bool TimeTable::solve() {
+    /* Find a timetable, warm started from the previous one */
+    vector<size_t> kept;
+    for (size_t id : current) {
+        if (available(id)) {
+            fix(id);
+            kept.push_back(id);
+        }
+    }
+    vector<size_t> found = kept;
+    bool ok = complete(found);
+    for (auto it = kept.rbegin(); it != kept.rend(); ++it) {
+        unfix(*it);
+    }
+    if (not ok and not kept.empty()) {
+        found.clear();
+        ok = complete(found);
+    }
+    current.clear();
+    if (ok) {
+        current = found;
+        sort(current.begin(), current.end());
+    }
+    return ok;
+}
@@ -0,0 +1,530 @@
+#include "bitset.h"
+#include "cells.h"
+#include "memo.h"
+#include "pentomino.h"
+#include "sudoku.h"
+#include "symmetry.h"
+#include "timetabler.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ *  Benchmark suite. Each suite runs in its own child process so its peak
+ *  resident set size can be measured, does one warm-up repetition, and then
+ *  times every instance over a number of repetitions.
+ *
+ *  usage: benchmark [-r reps] [-o results] [-c baseline] [-t threshold]
+ *                   [-s suite]
+ *
+ *  Results are written one suite per line as key=value pairs. When compared
+ *  with a baseline, a suite has changed significantly if its median time
+ *  per repetition moved by more than the threshold (default 0.05) and the
+ *  ranges of the repetition times do not overlap. The exit status is 1 if
+ *  any suite got significantly slower. With -s only the suites whose names
+ *  contain the given string are run.
+ */
+
+using Instance = std::function<void()>;
+
+struct Suite {
+    std::string name;
+    std::function<std::vector<Instance>()> setup;
+};
+
+struct Result {
+    std::string name;
+    size_t instances;
+    std::vector<double> times;         // Seconds per instance, all repetitions
+    std::vector<double> reps;          // Seconds per repetition
+    long rss_kb;
+
+    double percentile(double p) const {
+        std::vector<double> sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+        return sorted[rank];
+    }
+
+    double median_rep() const {
+        std::vector<double> sorted = reps;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+};
+
+std::vector<std::string> read_lines(const std::string& filename) {
+    std::ifstream in(filename);
+    std::vector<std::string> ret;
+    for (std::string line; std::getline(in, line);) {
+        if (not line.empty()) {
+            ret.push_back(line);
+        }
+    }
+    if (ret.empty()) {
+        std::cerr << "Could not read " << filename << '\n';
+        std::exit(2);
+    }
+    return ret;
+}
+
+template<int sz, bool use_cross_rule>
+std::vector<std::string> generate_puzzles(size_t count, unsigned seed) {
+    /* Random puzzles with unique solutions, removing clues until minimal */
+    const int sz2 = sz * sz;
+    std::minstd_rand rng(seed);
+    SparseMatrix M = sudoku::puzzle_matrix<sz, use_cross_rule>();
+    std::vector<std::string> ret;
+    while (ret.size() < count) {
+        M.policy = ColumnPolicy::random_min;
+        M.rng.seed(rng());
+        std::string puzzle = sudoku::format_solution<sz>(M.solve());
+        M.policy = ColumnPolicy::min_size;
+        std::vector<int> cells(sz2);
+        for (int i = 0; i < sz2; ++i) {
+            cells[i] = i;
+        }
+        std::shuffle(cells.begin(), cells.end(), rng);
+        for (int i : cells) {
+            char c = puzzle[i];
+            puzzle[i] = '.';
+            auto clues = sudoku::remove_clues<sz>(M, puzzle);
+            if (M.count_up_to(2) != 1) {
+                puzzle[i] = c;
+            }
+            sudoku::replace_clues(M, clues);
+        }
+        ret.push_back(puzzle);
+    }
+    return ret;
+}
+
+template<int sz, bool use_cross_rule>
+std::vector<Instance> sudoku_instances(std::vector<std::string> puzzles,
+                                       std::vector<std::string> expected,
+                                       sudoku::Engine engine = sudoku::Engine::dlx) {
+    auto solve = sudoku::puzzle_solver<sz, use_cross_rule>(engine);
+    std::vector<Instance> ret;
+    for (size_t i = 0; i < puzzles.size(); ++i) {
+        std::string puzzle = puzzles[i];
+        std::string solution = expected.empty() ? "" : expected[i];
+        ret.push_back([solve, puzzle, solution] {
+            std::string found = solve(puzzle);
+            if (found.empty() or (not solution.empty() and found != solution)) {
+                std::cerr << "Wrong solution for " << puzzle << '\n';
+                std::exit(2);
+            }
+        });
+    }
+    return ret;
+}
+
+std::vector<Instance> race_instances(std::vector<std::string> puzzles,
+                                    std::vector<std::string> expected,
+                                    std::vector<unsigned> seeds) {
+    /* 9x9 puzzles each solved by racing a search per seed */
+    auto M = std::make_shared<SparseMatrix>(sudoku::puzzle_matrix<9>());
+    std::vector<Instance> ret;
+    for (size_t i = 0; i < puzzles.size(); ++i) {
+        std::string puzzle = puzzles[i], solution = expected[i];
+        ret.push_back([M, seeds, puzzle, solution] {
+            auto clues = sudoku::remove_clues<9>(*M, puzzle);
+            std::string found = sudoku::format_solution<9>(M->solve_race(seeds));
+            sudoku::replace_clues(*M, clues);
+            if (found != solution) {
+                std::cerr << "Wrong solution for " << puzzle << '\n';
+                std::exit(2);
+            }
+        });
+    }
+    return ret;
+}
+
+std::shared_ptr<TimeTable> random_timetable(int num_rooms, int num_types,
+                                            int num_placements, unsigned seed) {
+    std::minstd_rand rng(seed);
+    auto ret = std::make_shared<TimeTable>(num_rooms, num_types);
+    for (int i = 0; i < num_placements; ++i) {
+        int length = 1 + rng() % 3;
+        ret->add({1 + int(rng() % num_types), int(rng() % num_rooms),
+                  int(rng() % (TimeTable::hours - length + 1)), length});
+    }
+    if (not ret->solve()) {
+        std::cerr << "No timetable\n";
+        std::exit(2);
+    }
+    return ret;
+}
+
+std::vector<Instance> timetable_edits(bool rebuild) {
+    /* Move a class of the timetable by withdrawing its placement, solve,
+     * then offer it again and solve */
+    auto t = random_timetable(10, 100, 800, 1);
+    std::vector<Instance> ret;
+    for (int i = 0; i < 50; ++i) {
+        ret.push_back([t, i, rebuild] {
+            size_t id = t->timetable()[i % t->timetable().size()];
+            for (int k = 0; k < 2; ++k) {
+                if (k == 0) {
+                    t->withdraw(id);
+                } else {
+                    t->add(t->placement(id));
+                }
+                bool ok;
+                if (rebuild) {
+                    TimeTable fresh(10, 100);
+                    for (size_t j = 0; j < t->size(); ++j) {
+                        if (t->offered(j)) {
+                            fresh.add(t->placement(j));
+                        }
+                    }
+                    ok = fresh.solve();
+                } else {
+                    ok = t->solve();
+                }
+                if (not ok) {
+                    std::cerr << "No timetable\n";
+                    std::exit(2);
+                }
+            }
+        });
+    }
+    return ret;
+}
+
+std::vector<Suite> suites() {
+    return {
+        {"construct_9x9", [] {
+            std::vector<Instance> ret(20, [] {
+                sudoku::puzzle_matrix<9>();
+            });
+            return ret;
+        }},
+        {"construct_pentomino", [] {
+            std::vector<Instance> ret(20, [] {
+                pentomino::create_matrix();
+            });
+            return ret;
+        }},
+        {"top95", [] {
+            return sudoku_instances<9, false>(
+                read_lines("tests/sudoku/top95.sudoku"),
+                read_lines("tests/sudoku/top95.solutions"));
+        }},
+        {"top95_race", [] {
+            return race_instances(read_lines("tests/sudoku/top95.sudoku"),
+                                  read_lines("tests/sudoku/top95.solutions"),
+                                  {0, 1, 2, 3});
+        }},
+        {"top2365", [] {
+            return sudoku_instances<9, false>(
+                read_lines("tests/sudoku/top2365.sudoku"),
+                read_lines("tests/sudoku/top2365.solutions"));
+        }},
+        {"top2365_bitboard", [] {
+            return sudoku_instances<9, false>(
+                read_lines("tests/sudoku/top2365.sudoku"),
+                read_lines("tests/sudoku/top2365.solutions"),
+                sudoku::Engine::bitboard);
+        }},
+        {"top2365_cells", [] {
+            // Not checked against the solutions, since dancing cells may
+            // find another solution of the puzzles that have several
+            return sudoku_instances<9, false>(
+                read_lines("tests/sudoku/top2365.sudoku"), {},
+                sudoku::Engine::cells);
+        }},
+        {"6x6", [] {
+            return sudoku_instances<6, false>(
+                generate_puzzles<6, false>(500, 1), {});
+        }},
+        {"9x9_cross", [] {
+            return sudoku_instances<9, true>(
+                generate_puzzles<9, true>(100, 1), {});
+        }},
+        {"9x9_cross_bitboard", [] {
+            return sudoku_instances<9, true>(
+                generate_puzzles<9, true>(100, 1), {}, sudoku::Engine::bitboard);
+        }},
+        {"9x9_cross_cells", [] {
+            return sudoku_instances<9, true>(
+                generate_puzzles<9, true>(100, 1), {}, sudoku::Engine::cells);
+        }},
+        {"pentomino_enumerate", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            return std::vector<Instance>(1, [M] {
+                if (M->solve_all().size() != 520) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"pentomino_enumerate_cells", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            return std::vector<Instance>(1, [M] {
+                if (DancingCells(*M).solve_all().size() != 520) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"pentomino_enumerate_bitset", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            return std::vector<Instance>(1, [M] {
+                size_t count = 0;
+                for_each_solution(*M, [&](const std::vector<HeadNode*>&) {
+                    return ++count > 0;
+                });
+                if (count != 520) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"pentomino_symmetric", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            Symmetry(*M, pentomino::board_symmetries()).reduce();
+            return std::vector<Instance>(1, [M] {
+                if (M->solve_all().size() != 65) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"pentomino_symmetric_bitset", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            Symmetry(*M, pentomino::board_symmetries()).reduce();
+            return std::vector<Instance>(1, [M] {
+                size_t count = 0;
+                for_each_solution(*M, [&](const std::vector<HeadNode*>&) {
+                    return ++count > 0;
+                });
+                if (count != 65) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"pentomino_count_memo", [] {
+            auto M = std::make_shared<SparseMatrix>(pentomino::create_matrix());
+            return std::vector<Instance>(1, [M] {
+                if (MemoCounter(*M).count() != 520) {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"dominoes_count_memo", [] {
+            // 10x10 board, whose tilings are far too many to enumerate
+            auto M = std::make_shared<SparseMatrix>(100);
+            for (size_t cell = 0; cell < 100; ++cell) {
+                if (cell % 10 < 9) {
+                    M->add_row(2 * cell, {cell, cell + 1});
+                }
+                if (cell < 90) {
+                    M->add_row(2 * cell + 1, {cell, cell + 10});
+                }
+            }
+            return std::vector<Instance>(1, [M] {
+                if (MemoCounter(*M).count().to_string() != "258584046368") {
+                    std::cerr << "Wrong number of tilings\n";
+                    std::exit(2);
+                }
+            });
+        }},
+        {"timetable_edit", [] {
+            return timetable_edits(false);
+        }},
+        {"timetable_rebuild", [] {
+            return timetable_edits(true);
+        }},
+    };
+}
+
+void run_suite(const Suite& suite, int num_reps, std::ostream& os) {
+    using clock = std::chrono::steady_clock;
+    std::vector<Instance> instances = suite.setup();
+    for (Instance& instance : instances) {
+        instance();
+    }
+    os << instances.size() << ' ' << num_reps << '\n';
+    for (int r = 0; r < num_reps; ++r) {
+        for (Instance& instance : instances) {
+            auto t = clock::now();
+            instance();
+            std::chrono::duration<double> dt = clock::now() - t;
+            os << dt.count() << '\n';
+        }
+    }
+}
+
+Result run_in_child(const Suite& suite, int num_reps) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        std::exit(2);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        std::ostringstream os;
+        os.precision(9);
+        run_suite(suite, num_reps, os);
+        std::string out = os.str();
+        for (size_t done = 0; done < out.size();) {
+            ssize_t n = write(fds[1], out.data() + done, out.size() - done);
+            if (n <= 0) {
+                _exit(2);
+            }
+            done += n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string out;
+    char buffer[4096];
+    for (ssize_t n; (n = read(fds[0], buffer, sizeof buffer)) > 0;) {
+        out.append(buffer, n);
+    }
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+        std::cerr << "Suite " << suite.name << " failed\n";
+        std::exit(2);
+    }
+
+    Result ret{suite.name, 0, {}, {}, usage.ru_maxrss};
+    std::istringstream is(out);
+    int reps;
+    is >> ret.instances >> reps;
+    for (int r = 0; r < reps; ++r) {
+        double total = 0;
+        for (size_t i = 0; i < ret.instances; ++i) {
+            double t;
+            is >> t;
+            ret.times.push_back(t);
+            total += t;
+        }
+        ret.reps.push_back(total);
+    }
+    return ret;
+}
+
+std::string format(const Result& r) {
+    std::ostringstream os;
+    os.precision(6);
+    os << r.name
+       << " instances=" << r.instances
+       << " p50=" << r.percentile(0.50)
+       << " p99=" << r.percentile(0.99)
+       << " max=" << r.percentile(1.0)
+       << " throughput=" << r.instances / r.median_rep()
+       << " rss_kb=" << r.rss_kb
+       << " reps=";
+    for (size_t i = 0; i < r.reps.size(); ++i) {
+        os << (i == 0 ? "" : ",") << r.reps[i];
+    }
+    return os.str();
+}
+
+std::map<std::string, std::vector<double>> read_baseline(const std::string& filename) {
+    /* Repetition times of each suite in a results file */
+    std::map<std::string, std::vector<double>> ret;
+    for (const std::string& line : read_lines(filename)) {
+        std::istringstream is(line);
+        std::string name, field;
+        is >> name;
+        while (is >> field) {
+            if (field.compare(0, 5, "reps=") == 0) {
+                std::istringstream values(field.substr(5));
+                for (std::string v; std::getline(values, v, ',');) {
+                    ret[name].push_back(std::stod(v));
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+bool compare(const Result& r, std::vector<double> base, double threshold) {
+    /* Print the change from the baseline, return false on a regression */
+    std::sort(base.begin(), base.end());
+    double old_median = base[base.size() / 2];
+    double change = r.median_rep() / old_median - 1;
+    auto range = std::minmax_element(r.reps.begin(), r.reps.end());
+    bool overlap = *range.first <= base.back() and base.front() <= *range.second;
+    bool significant = std::abs(change) > threshold and not overlap;
+    std::cout << "  " << r.name << ": " << (change > 0 ? "+" : "")
+              << 100 * change << "% "
+              << (not significant ? "(not significant)"
+                  : change > 0 ? "REGRESSION" : "improvement")
+              << '\n';
+    return not (significant and change > 0);
+}
+
+int main(int argc, char* argv[]) {
+    int num_reps = 5;
+    double threshold = 0.05;
+    std::string output, baseline, only;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "-r") {
+            num_reps = std::max(1, std::atoi(argv[i + 1]));
+        } else if (flag == "-o") {
+            output = argv[i + 1];
+        } else if (flag == "-c") {
+            baseline = argv[i + 1];
+        } else if (flag == "-t") {
+            threshold = std::atof(argv[i + 1]);
+        } else if (flag == "-s") {
+            only = argv[i + 1];
+        } else {
+            std::cout << "usage: benchmark [-r reps] [-o results] "
+                         "[-c baseline] [-t threshold] [-s suite]\n";
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    for (const Suite& suite : suites()) {
+        if (suite.name.find(only) == std::string::npos) {
+            continue;
+        }
+        results.push_back(run_in_child(suite, num_reps));
+        std::cout << format(results.back()) << std::endl;
+    }
+    if (not output.empty()) {
+        std::ofstream os(output);
+        for (const Result& r : results) {
+            os << format(r) << '\n';
+        }
+    }
+    bool ok = true;
+    if (not baseline.empty()) {
+        auto base = read_baseline(baseline);
+        std::cout << "Compared with " << baseline << ":\n";
+        for (const Result& r : results) {
+            if (base.count(r.name)) {
+                ok = compare(r, base[r.name], threshold) and ok;
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,725 @@
+#include "bitset.h"
+#include "cells.h"
+#include "matrix.h"
+#include "memo.h"
+#include "pentomino.h"
+#include "search.h"
+#include "sudoku.h"
+#include "symmetry.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+// Example exact cover problem from Knuth's "Dancing Links" paper
+SparseMatrix knuth_example() {
+    SparseMatrix m(7);
+    m.create_row(0, {2, 4, 5});
+    m.create_row(1, {0, 3, 6});
+    m.create_row(2, {1, 2, 5});
+    m.create_row(3, {0, 3});
+    m.create_row(4, {1, 6});
+    m.create_row(5, {3, 4, 6});
+    return m;
+}
+
+std::set<size_t> row_data(const std::vector<HeadNode*>& solution) {
+    std::set<size_t> ret;
+    for (HeadNode *n : solution) {
+        ret.insert(n->data);
+    }
+    return ret;
+}
+
+bool same_links(const SparseMatrix& a, const SparseMatrix& b) {
+    if (a.nodes.size() != b.nodes.size() or a.cols.size() != b.cols.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.nodes.size(); ++i) {
+        if (a.nodes[i].above != b.nodes[i].above or
+            a.nodes[i].below != b.nodes[i].below or
+            a.nodes[i].top != b.nodes[i].top) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.cols.size(); ++i) {
+        if (a.cols[i].left != b.cols[i].left or
+            a.cols[i].right != b.cols[i].right) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool solve() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    return row_data(m.solve()) == std::set<size_t>{0, 3, 4};
+}
+
+bool solve_all() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    m.create_row(6, {0, 1, 2, 3, 4, 5, 6});
+    auto solutions = m.solve_all();
+    if (solutions.size() != 2) {
+        return false;
+    }
+    return row_data(solutions[0]) == std::set<size_t>{0, 3, 4} and
+           row_data(solutions[1]) == std::set<size_t>{6};
+}
+
+bool up_to() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    m.create_row(6, {0, 1, 2, 3, 4, 5, 6});
+    const SparseMatrix original = m;
+    auto first = m.solve_up_to(1);
+    if (first.size() != 1 or row_data(first[0]) != std::set<size_t>{0, 3, 4}) {
+        return false;
+    }
+    return m.count_up_to(1) == 1 and m.count_up_to(2) == 2 and
+           m.count_up_to(100) == 2 and same_links(m, original);
+}
+
+bool stats() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    m.solve_all();
+    if (not stats_enabled) {
+        return m.stats.nodes() == 0 and m.stats.updates == 0;
+    }
+    // Every node removed during the search is replaced again
+    return m.stats.solutions == 1 and m.stats.nodes_per_depth[0] == 1 and
+           m.stats.updates % 2 == 0 and m.stats.dead_ends > 0;
+}
+
+bool predicate() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    SparseMatrix p(m.rows.size(), 7, [&m](size_t j, size_t i) {
+        for (Link x = m.rows[i].first; m.nodes[x].top > 0; ++x) {
+            if (size_t(m.nodes[x].top) == j + 1) {
+                return true;
+            }
+        }
+        return false;
+    });
+    return same_links(m, p);
+}
+
+bool add_rows() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    SparseMatrix r(7);
+    r.reserve(6, 16);
+    r.add_row(0, std::vector<int>{2, 4, 5});
+    r.add_row(1, std::array<size_t, 3>{{0, 3, 6}});
+    r.add_row(2, {1, 2, 5});
+    r.add_row(3, {0, 3});
+    r.add_row(4, {1, 6});
+    r.add_row(5, std::set<int>{3, 4, 6});
+    if (not same_links(m, r)) {
+        return false;
+    }
+    // Every constraint of the empty sudoku can be met by one of 9 rows
+    SparseMatrix s = sudoku::puzzle_matrix<9, true>();
+    if (s.rows.size() != 729 or s.cols.size() != 6 * 81 + 1) {
+        return false;
+    }
+    for (Link c = 1; c < s.cols.size(); ++c) {
+        if (s.nodes[c].top != 9) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr MatrixLayout<6, 7, 16> knuth_layout() {
+    MatrixLayout<6, 7, 16> ret;
+    const int rows[6][4] = {
+        {2, 4, 5}, {0, 3, 6}, {1, 2, 5}, {0, 3}, {1, 6}, {3, 4, 6},
+    };
+    const size_t sizes[6] = {3, 3, 3, 2, 2, 3};
+    for (size_t i = 0; i < 6; ++i) {
+        ret.add_row(i, rows[i], sizes[i]);
+    }
+    return ret;
+}
+
+bool layout() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    constexpr MatrixLayout<6, 7, 16> knuth = knuth_layout();
+    static_assert(knuth.num_nodes == 7 + 2 + 16 + 6, "one node per entry");
+    if (not same_links(SparseMatrix(knuth), knuth_example())) {
+        return false;
+    }
+    SparseMatrix s(4 * 36);
+    for (int r = 0; r < 216; ++r) {
+        std::vector<int> cols;
+        for (int t = 0; t < 4; ++t) {
+            cols.push_back(t * 36 + sudoku::constraint<6>(t, r / 6 % 6, r / 36, r % 6));
+        }
+        s.add_row(r, cols);
+    }
+    return same_links(s, sudoku::puzzle_matrix<6>());
+}
+
+bool restore() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = knuth_example();
+    const SparseMatrix original = m;
+    m.remove_row(&m.rows[3]);
+    m.remove_row(&m.rows[1]);
+    if (not m.solve().empty()) {
+        return false;
+    }
+    m.replace_row(&m.rows[1]);
+    m.replace_row(&m.rows[3]);
+    m.solve_all();
+    return same_links(m, original);
+}
+
+bool reset() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = sudoku::puzzle_matrix<9>();
+    const SparseMatrix original = m;
+    // Leave a search part way through without restoring anything
+    m.remove_row(&m.rows[5]);
+    Link c = m.min_col();
+    m.remove_col_and_rows(c);
+    m.choose_row(m.nodes[c].below);
+    SparseMatrix copy = m;
+    m.reset();
+    if (not same_links(m, original) or same_links(copy, original)) {
+        return false;
+    }
+    copy.reset();
+    return same_links(copy, original) and
+           sudoku::format_solution<9>(copy.solve()) ==
+           sudoku::format_solution<9>(sudoku::puzzle_matrix<9>().solve());
+}
+
+bool symmetry() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = pentomino::create_matrix();
+    std::set<std::set<size_t>> all;
+    for (const auto& sol : m.solutions()) {
+        all.insert(row_data(sol));
+    }
+    Symmetry symmetry(m, pentomino::board_symmetries());
+    auto removed = symmetry.reduce();
+    std::set<std::set<size_t>> expanded;
+    size_t canonical = 0;
+    for (const auto& sol : m.solutions()) {
+        ++canonical;
+        for (const auto& image : symmetry.expand(sol)) {
+            expanded.insert(row_data(image));
+        }
+    }
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+        m.replace_row(*it);
+    }
+    return symmetry.order() == 8 and symmetry.column() == 0 and
+           canonical == 65 and expanded == all and all.size() == 520 and
+           same_links(m, pentomino::create_matrix());
+}
+
+bool symmetry_invalid() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Permutations that are not symmetries of the matrix are refused
+    SparseMatrix m = pentomino::create_matrix();
+    std::vector<size_t> swapped(m.cols.size() - 1);
+    std::iota(swapped.begin(), swapped.end(), 0);
+    std::swap(swapped[0], swapped[1]);   // Two pieces of different shapes
+    std::vector<size_t> narrow(swapped.begin(), swapped.end() - 1);
+    std::vector<size_t> outside = narrow, repeated = narrow;
+    outside.push_back(narrow.size() + 1);
+    repeated.push_back(0);
+    int refused = 0;
+    for (const auto& perm : {swapped, narrow, outside, repeated}) {
+        try {
+            Symmetry(m, {perm});
+        } catch (const std::invalid_argument&) {
+            ++refused;
+        }
+    }
+    // A map of the columns onto one, though each image is a row, and two
+    // rows of the same columns
+    SparseMatrix pair(2), twice(1);
+    pair.add_row(0, {0});
+    pair.add_row(1, {1});
+    twice.add_row(0, {0});
+    twice.add_row(1, {0});
+    for (auto test : {std::make_pair(&pair, std::vector<size_t>{0, 0}),
+                      std::make_pair(&twice, std::vector<size_t>{0})}) {
+        try {
+            Symmetry(*test.first, {test.second});
+        } catch (const std::invalid_argument&) {
+            ++refused;
+        }
+    }
+    return refused == 6 and same_links(m, pentomino::create_matrix());
+}
+
+bool symmetry_secondary() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // The only fixed column is secondary, so a solution need not use it
+    // and it cannot be reduced
+    SparseMatrix m(2, 3);
+    for (auto cols : {std::vector<size_t>{0}, {1}, {0, 2}, {1, 3}, {0, 4}, {1, 4}}) {
+        m.add_row(0, cols);
+    }
+    std::set<std::vector<HeadNode*>> all;
+    for (auto sol : m.solve_all()) {
+        std::sort(sol.begin(), sol.end());
+        all.insert(sol);
+    }
+    Symmetry symmetry(m, {{0, 1, 2, 3, 4}, {1, 0, 3, 2, 4}});
+    symmetry.reduce();
+    std::set<std::vector<HeadNode*>> expanded;
+    for (const auto& sol : m.solve_all()) {
+        for (auto image : symmetry.expand(sol)) {
+            std::sort(image.begin(), image.end());
+            expanded.insert(image);
+        }
+    }
+    return symmetry.column() >= 5 and all.size() == 8 and expanded == all;
+}
+
+bool parallel() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = pentomino::create_matrix();
+    auto serial = m.solve_all();
+    for (unsigned num_threads : {1, 3, 8}) {
+        if (m.solve_all(num_threads) != serial) {
+            return false;
+        }
+    }
+    return serial.size() == 520;
+}
+
+bool resume() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = pentomino::create_matrix();
+    const SparseMatrix original = m;
+    auto serial = m.solve_all();
+    std::vector<std::vector<HeadNode*>> stepped;
+    {
+        Search search(m);
+        for (Search::Status s; (s = search.step(7)) != Search::exhausted;) {
+            if (s == Search::found) {
+                stepped.push_back(search.solution());
+            }
+        }
+    }
+    if (stepped != serial or not same_links(m, original)) {
+        return false;
+    }
+    // Abandoning a search part way through restores the matrix
+    Search search(m);
+    search.step(1000);
+    search.step(10);
+    search.abort();
+    return search.nodes() == 1010 and same_links(m, original);
+}
+
+bool lazy() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = pentomino::create_matrix();
+    const SparseMatrix original = m;
+    auto serial = m.solve_all();
+    size_t count = 0;
+    for (const auto& solution : m.solutions()) {
+        if (solution != serial[count++]) {
+            return false;
+        }
+        if (count == 3) {
+            break;
+        }
+    }
+    return count == 3 and same_links(m, original);
+}
+
+bool policies() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix k = knuth_example();
+    k.policy = ColumnPolicy::first;
+    if (row_data(k.solve()) != std::set<size_t>{0, 3, 4}) {
+        return false;
+    }
+    // Wide enough for the column size index, with 156 solutions
+    std::string puzzle = std::string(27, '.') +
+        "825437169791586432346912758289643571573291684164875293";
+    SparseMatrix m = sudoku::puzzle_matrix<9>(puzzle);
+    std::set<std::set<size_t>> expected, found;
+    for (const auto& solution : m.solve_all()) {
+        expected.insert(row_data(solution));
+    }
+    m.policy = ColumnPolicy::random_min;
+    for (const auto& solution : m.solve_all()) {
+        found.insert(row_data(solution));
+    }
+    return expected.size() == 156 and found == expected;
+}
+
+SparseMatrix queens(int n) {
+    /* Ranks and files are primary, the diagonals secondary */
+    SparseMatrix m(2 * n, 4 * n - 2);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            m.add_row(i * n + j, {size_t(i), size_t(n + j),
+                                  size_t(2 * n + i + j), size_t(5 * n - 2 + i - j)});
+        }
+    }
+    return m;
+}
+
+bool secondary() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = queens(8);
+    const SparseMatrix original = m;
+    if (m.solve_all().size() != 92 or not same_links(m, original)) {
+        return false;
+    }
+    // Wide enough for the column size index
+    SparseMatrix w = queens(24);
+    std::set<size_t> squares = row_data(w.solve());
+    std::set<int> diagonals, antidiagonals;
+    for (size_t x : squares) {
+        diagonals.insert(x / 24 + x % 24);
+        antidiagonals.insert(x / 24 - x % 24);
+    }
+    return squares.size() == 24 and diagonals.size() == 24 and antidiagonals.size() == 24;
+}
+
+bool colors() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Knuth's example: primary p, q, r and secondary x, y with colors A, B
+    const int A = 1, B = 2;
+    SparseMatrix m(3, 2);
+    m.add_row(0, std::vector<size_t>{0, 1, 3, 4}, std::vector<int>{0, 0, 0, A});
+    m.add_row(1, std::vector<size_t>{0, 2, 3, 4}, std::vector<int>{0, 0, A, 0});
+    m.add_row(2, std::vector<size_t>{0, 3}, std::vector<int>{0, B});
+    m.add_row(3, std::vector<size_t>{1, 3}, std::vector<int>{0, A});
+    m.add_row(4, std::vector<size_t>{2, 4}, std::vector<int>{0, B});
+    const SparseMatrix original = m;
+    auto all = m.solve_all();
+    return all.size() == 1 and row_data(all[0]) == std::set<size_t>{1, 3} and
+           same_links(m, original) and m.colors == original.colors;
+}
+
+bool multiplicities() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Any two of four rows covering one column
+    SparseMatrix pairs(1);
+    for (size_t i = 0; i < 4; ++i) {
+        pairs.add_row(i, {0});
+    }
+    pairs.set_multiplicity(0, 2, 2);
+    if (pairs.solve_all().size() != 6) {
+        return false;
+    }
+
+    // Random matrices with a secondary column against every subset of rows
+    std::minstd_rand rng(1);
+    for (int trial = 0; trial < 200; ++trial) {
+        const size_t width = 4, height = 10;
+        SparseMatrix m(width - 1, 1);
+        std::vector<std::vector<size_t>> row_cols(height);
+        for (size_t i = 0; i < height; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                if (rng() % 3 == 0 or j == i % (width - 1)) {
+                    row_cols[i].push_back(j);
+                }
+            }
+            m.add_row(i, row_cols[i]);
+        }
+        std::vector<size_t> lo(width, 0), hi(width, 1);
+        for (size_t j = 0; j + 1 < width; ++j) {
+            lo[j] = rng() % 3;
+            hi[j] = std::max<size_t>(1, lo[j] + rng() % 3);
+            m.set_multiplicity(j, lo[j], hi[j]);
+        }
+
+        std::set<std::set<size_t>> expected, found;
+        for (size_t subset = 0; subset < (1u << height); ++subset) {
+            std::vector<size_t> count(width);
+            std::set<size_t> rows;
+            for (size_t i = 0; i < height; ++i) {
+                if (subset >> i & 1) {
+                    rows.insert(i);
+                    for (size_t j : row_cols[i]) {
+                        ++count[j];
+                    }
+                }
+            }
+            bool ok = true;
+            for (size_t j = 0; j < width; ++j) {
+                ok = ok and lo[j] <= count[j] and count[j] <= hi[j];
+            }
+            if (ok) {
+                expected.insert(rows);
+            }
+        }
+        const SparseMatrix original = m;
+        auto all = m.solve_all();
+        for (const auto& solution : all) {
+            found.insert(row_data(solution));
+        }
+        if (found != expected or all.size() != found.size() or
+            not same_links(m, original) or m.bounds != original.bounds) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool dancing_cells() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix k = knuth_example();
+    if (row_data(DancingCells(k).solve()) != std::set<size_t>{0, 3, 4}) {
+        return false;
+    }
+    SparseMatrix q = queens(8);
+    if (DancingCells(q).solve_all().size() != 92) {
+        return false;
+    }
+    // Same solutions as the links, with the removed rows left out
+    SparseMatrix m = pentomino::create_matrix();
+    auto removed = Symmetry(m, pentomino::board_symmetries()).reduce();
+    std::set<std::set<size_t>> expected, found;
+    for (const auto& solution : m.solve_all()) {
+        expected.insert(row_data(solution));
+    }
+    DancingCells cells(m);
+    auto all = cells.solve_all();
+    for (const auto& solution : all) {
+        found.insert(row_data(solution));
+    }
+    return expected.size() == 65 and all.size() == 65 and found == expected and
+           cells.count_up_to(10) == 10 and cells.solve_up_to(3).size() == 3 and
+           cells.solve_all().size() == 65 and not removed.empty();
+}
+
+bool bitset() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix k = knuth_example();
+    if (row_data(BitsetSolver(k).solve()) != std::set<size_t>{0, 3, 4}) {
+        return false;
+    }
+    // The same solutions in the same order as the links, with and without
+    // AVX2, with removed rows left out and secondary columns
+    SparseMatrix m = pentomino::create_matrix();
+    Symmetry(m, pentomino::board_symmetries()).reduce();
+    SparseMatrix q = queens(8), w = queens(24);
+    for (bool simd : {false, true}) {
+        BitsetSolver b(m, simd);
+        if (b.solve_all() != m.solve_all() or b.count_up_to(10) != 10 or
+            b.solve_up_to(3).size() != 3 or
+            BitsetSolver(q, simd).solve_all() != q.solve_all() or
+            BitsetSolver(w, simd).solve() != w.solve()) {
+            return false;
+        }
+    }
+
+    // Random matrices of every width the bitsets are padded to, each made
+    // of two partitions of the columns into rows
+    std::minstd_rand rng(1);
+    for (size_t width : {40, 100, 200, 500}) {
+        SparseMatrix r(width - width / 8, width / 8);
+        size_t data = 0;
+        for (int partition = 0; partition < 2; ++partition) {
+            std::vector<size_t> cols;
+            for (size_t j = 0; j < width; ++j) {
+                cols.push_back(j);
+                if (rng() % 8 == 0 or j + 1 == width) {
+                    r.add_row(data++, cols);
+                    cols.clear();
+                }
+            }
+        }
+        auto expected = r.solve_all();
+        std::vector<std::vector<HeadNode*>> each;
+        for_each_solution(r, [&](const std::vector<HeadNode*>& sol) {
+            each.push_back(sol);
+            return true;
+        });
+        if (expected.empty() or not BitsetSolver::suits(r) or
+            BitsetSolver(r, false).solve_all() != expected or
+            BitsetSolver(r).solve_all() != expected or each != expected) {
+            return false;
+        }
+    }
+    SparseMatrix wide(BitsetSolver::max_width + 1), colored(1, 1);
+    colored.add_row(0, std::vector<size_t>{0, 1}, std::vector<int>{0, 1});
+    return not BitsetSolver::suits(wide) and not BitsetSolver::suits(colored);
+}
+
+SparseMatrix dominoes(size_t height, size_t width) {
+    /* Tilings of a board by dominoes */
+    SparseMatrix m(height * width);
+    for (size_t i = 0; i < height; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            size_t cell = i * width + j;
+            if (j + 1 < width) {
+                m.add_row(2 * cell, {cell, cell + 1});
+            }
+            if (i + 1 < height) {
+                m.add_row(2 * cell + 1, {cell, cell + width});
+            }
+        }
+    }
+    return m;
+}
+
+bool memo() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    Natural n(std::uint64_t(1) << 63);
+    n += n;
+    if (n.to_string() != "18446744073709551616" or Natural().to_string() != "0") {
+        return false;
+    }
+    SparseMatrix q = queens(8);
+    const SparseMatrix original = q;
+    if (MemoCounter(q).count() != 92 or not same_links(q, original)) {
+        return false;
+    }
+    // The diagram holds the same solutions as the links, even when the
+    // cache has room for a single entry
+    SparseMatrix m = pentomino::create_matrix();
+    std::set<std::set<size_t>> expected, found;
+    for (const auto& solution : m.solve_all()) {
+        expected.insert(row_data(solution));
+    }
+    for (size_t bytes : {size_t(1), size_t(1) << 20}) {
+        MemoCounter counter(m, bytes);
+        Zdd zdd = counter.zdd();
+        auto all = zdd.solutions();
+        found.clear();
+        for (const auto& solution : all) {
+            found.insert(row_data(solution));
+        }
+        if (zdd.count() != 520 or all.size() != 520 or found != expected or
+            counter.count() != 520) {
+            return false;
+        }
+    }
+    // Far more tilings than could be listed, and than fit in 64 bits
+    SparseMatrix d = dominoes(8, 8), strip = dominoes(2, 100);
+    MemoCounter counter(strip);
+    return MemoCounter(d).count() == 12988816 and
+           counter.count().to_string() == "573147844013817084101" and
+           counter.zdd().count() == counter.count() and counter.hits > 0;
+}
+
+bool race() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix k = knuth_example();
+    if (k.solve_race({0}) != k.solve() or k.solve_race({1, 2}).size() != 3) {
+        return false;
+    }
+    // The same valid solution whichever search gets there first
+    SparseMatrix m = pentomino::create_matrix();
+    const SparseMatrix original = m;
+    std::set<std::set<size_t>> all;
+    for (const auto& solution : m.solve_all()) {
+        all.insert(row_data(solution));
+    }
+    std::vector<unsigned> seeds{0, 1, 2, 3, 4, 5, 6, 7};
+    auto first = m.solve_race(seeds);
+    for (int rep = 0; rep < 10; ++rep) {
+        if (m.solve_race(seeds) != first) {
+            return false;
+        }
+    }
+    // No solution once a column is empty
+    SparseMatrix e(3);
+    e.add_row(0, {0, 1});
+    // Too few or too many seeds are refused
+    int refused = 0;
+    for (size_t n : {size_t(0), size_t(1) << 16}) {
+        try {
+            e.solve_race(std::vector<unsigned>(n));
+        } catch (const std::invalid_argument&) {
+            ++refused;
+        }
+    }
+    return all.count(row_data(first)) == 1 and same_links(m, original) and
+           e.solve_race(seeds).empty() and refused == 2;
+}
+
+bool limits() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    SparseMatrix m = pentomino::create_matrix();
+    const SparseMatrix original = m;
+    auto serial = m.solve_all();
+    SolveResult all = m.solve_all(Limits());
+    if (all.status != SolveResult::exhausted or all.solutions != serial or
+        all.updates == 0 or not same_links(m, original)) {
+        return false;
+    }
+    // Stopped part way, with the solutions so far and the matrix restored
+    Limits few;
+    few.nodes = all.nodes / 2;
+    SolveResult half = m.solve_all(few);
+    if (half.status != SolveResult::limit_hit or half.nodes != few.nodes or
+        half.solutions.empty() or half.solutions.size() >= serial.size() or
+        not std::equal(half.solutions.begin(), half.solutions.end(), serial.begin()) or
+        not same_links(m, original)) {
+        return false;
+    }
+    Limits updates;
+    updates.updates = 100000;
+    SolveResult u = m.solve_all(updates);
+    if (u.status != SolveResult::limit_hit or u.updates < updates.updates or
+        not same_links(m, original)) {
+        return false;
+    }
+    Limits late;
+    late.deadline = std::chrono::steady_clock::now();
+    SolveResult d = m.solve(late);
+    if (d.status != SolveResult::limit_hit or not same_links(m, original)) {
+        return false;
+    }
+    SolveResult one = m.solve(few);
+    SparseMatrix e(3);
+    e.add_row(0, {0, 1});
+    return one.status == SolveResult::solved and one.solutions.size() == 1 and
+           one.solutions[0] == serial[0] and
+           e.solve(few).status == SolveResult::exhausted;
+}
+
+int main() {
+    assert(solve());
+    assert(solve_all());
+    assert(up_to());
+    assert(stats());
+    assert(predicate());
+    assert(add_rows());
+    assert(layout());
+    assert(restore());
+    assert(reset());
+    assert(symmetry());
+    assert(symmetry_invalid());
+    assert(symmetry_secondary());
+    assert(parallel());
+    assert(resume());
+    assert(lazy());
+    assert(policies());
+    assert(secondary());
+    assert(colors());
+    assert(multiplicities());
+    assert(dancing_cells());
+    assert(bitset());
+    assert(memo());
+    assert(race());
+    assert(limits());
+    std::cout << "All tests passed!\n";
+}
@@ -1,7 +1,13 @@
+#include "bitset.h"
 #include "pentomino.h"
+#include "symmetry.h"
 
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 
 using namespace pentomino;
 
@@ -11,7 +17,7 @@ std::string format_solution(std::vector<HeadNode*> sol) {
         int data = n->data;
         int y = data % 8;
         int x = (data /= 8) % 8;
-        const Pentomino& pentomino = fixed_pentominoes()[data /= 8];
+        const Pentomino& pentomino = fixed_pentominoes[data /= 8];
         for (Position p : pentomino.squares) {
             p.x += x;
             p.y += y;
@@ -21,9 +27,55 @@ std::string format_solution(std::vector<HeadNode*> sol) {
     return ret;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool parallel = false, reduce = false, expand = false;
+    unsigned num_threads = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j") {
+            parallel = true;
+            if (i + 1 < argc and std::isdigit(argv[i + 1][0])) {
+                num_threads = std::atoi(argv[++i]);
+            }
+        } else if (arg == "-s") {
+            reduce = true;
+        } else if (arg == "-e") {
+            reduce = expand = true;
+        } else {
+            std::cout << "usage: pentomino_enumerate [options]\n";
+            std::cout << "   -j [threads]   Enumerate in parallel\n";
+            std::cout << "   -s             One tiling for each symmetry of the board\n";
+            std::cout << "   -e             As -s, printing every image of each tiling\n";
+            return 0;
+        }
+    }
+
     SparseMatrix m = create_matrix();
-    for (const auto& sol : m.solve_all()) {
-        std::cout << format_solution(sol) << '\n';
+    std::unique_ptr<Symmetry> symmetry;
+    if (reduce) {
+        symmetry.reset(new Symmetry(m, board_symmetries()));
+        symmetry->reduce();
+    }
+    auto print = [&](const std::vector<HeadNode*>& sol) {
+        if (expand) {
+            for (const auto& image : symmetry->expand(sol)) {
+                std::cout << format_solution(image) << '\n';
+            }
+        } else {
+            std::cout << format_solution(sol) << '\n';
+        }
+    };
+    if (parallel) {
+        // Enumerate in parallel, printing once the search has finished
+        for (const auto& sol : m.solve_all(num_threads)) {
+            print(sol);
+        }
+    } else {
+        // Printing each tiling as it is found, by the bitset engine where
+        // it suits the matrix
+        for_each_solution(m, [&](const std::vector<HeadNode*>& sol) {
+            print(sol);
+            return true;
+        });
     }
 }
@@ -0,0 +1,124 @@
+#include "polyomino.h"
+#include "search.h"
+#include "symmetry.h"
+
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace polyomino;
+
+std::set<size_t> row_data(const std::vector<HeadNode*>& solution) {
+    std::set<size_t> ret;
+    for (const HeadNode *n : solution) {
+        ret.insert(n->data);
+    }
+    return ret;
+}
+
+std::vector<Piece> pentominoes() {
+    return {
+        {'F', {".##", "##.", ".#."}},
+        {'I', {"#####"}},
+        {'L', {"####", "#..."}},
+        {'N', {"###.", "..##"}},
+        {'P', {"###", "##."}},
+        {'T', {"###", ".#.", ".#."}},
+        {'U', {"#.#", "###"}},
+        {'V', {"#..", "#..", "###"}},
+        {'W', {"#..", "##.", ".##"}},
+        {'X', {".#.", "###", ".#."}},
+        {'Y', {"####", ".#.."}},
+        {'Z', {"##.", ".#.", ".##"}},
+    };
+}
+
+std::vector<std::string> scott_board() {
+    // Dana Scott's problem, the chessboard with the centre removed
+    std::vector<std::string> ret(8, "########");
+    ret[3] = ret[4] = "###..###";
+    return ret;
+}
+
+bool placements() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    Tiling t(scott_board(), pentominoes());
+    std::ostringstream report;
+    t.report(report);
+    return t.placements().size() == 1568 and t.height() == 1568 and
+           t.width() == 72 and t.nonzeros() == 1568 * 6 and
+           report.str().find("1568 placements") != std::string::npos;
+}
+
+bool orientations() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    std::vector<std::string> board(4, "####");
+    Piece l('L', {"###", "#.."});
+    Piece square('O', {"##", "##"});
+    return Tiling(board, {l}).placements().size() == 8 * 6 and
+           Tiling(board, {l}, false).placements().size() == 4 * 6 and
+           Tiling(board, {square}).placements().size() == 9;
+}
+
+bool tilings() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    Tiling t(scott_board(), pentominoes());
+    SparseMatrix m = t.matrix();
+    Symmetry symmetry(m, t.symmetries());
+    symmetry.reduce();
+    size_t count = 0;
+    std::string first;
+    for (const auto& sol : m.solutions()) {
+        if (count++ == 0) {
+            first = t.format(sol);
+        }
+    }
+    return symmetry.order() == 8 and count == 65 and first.size() == 8 * 9 and
+           first.find('#') == std::string::npos and first[3 * 9 + 3] == ' ';
+}
+
+bool copies() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Two dominoes tile a square in two ways, and four a 2x4 board in five,
+    // each found once whatever the order of the copies
+    Tiling t({"##", "##"}, {Piece('D', {"##"}, 2)});
+    SparseMatrix m = t.matrix();
+    SparseMatrix strip = Tiling({"####", "####"}, {Piece('D', {"##"}, 4)}).matrix();
+    return t.placements().size() == 4 and t.height() == 4 and t.width() == 5 and
+           m.solve_all().size() == 2 and strip.solve_all().size() == 5 and
+           t.symmetries().size() == 8 and
+           Tiling({"####", "####"}, {}).symmetries().size() == 4;
+}
+
+bool rotations_only() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Without reflections of the chiral L, only rotations are symmetries
+    std::vector<std::string> board(4, "####");
+    Tiling t(board, {Piece('L', {"###", "#.."}, 2), Piece('O', {"##", "##"}),
+                     Piece('I', {"####"})}, false);
+    SparseMatrix m = t.matrix();
+    std::set<std::set<size_t>> all, expanded;
+    for (const auto& sol : m.solve_all()) {
+        all.insert(row_data(sol));
+    }
+    Symmetry symmetry(m, t.symmetries());
+    symmetry.reduce();
+    for (const auto& sol : m.solve_all()) {
+        for (const auto& image : symmetry.expand(sol)) {
+            expanded.insert(row_data(image));
+        }
+    }
+    return symmetry.order() == 4 and not all.empty() and expanded == all;
+}
+
+int main() {
+    assert(placements());
+    assert(orientations());
+    assert(tilings());
+    assert(copies());
+    assert(rotations_only());
+    std::cout << "All tests passed!\n";
+}
@@ -1,9 +1,41 @@
+#include "socket.h"
 #include "sudoku.h"
 
+#include <cstdio>
 #include <iostream>
+#include <memory>
 #include <string>
 
+int serve_socket(const char *path) {
+	/*
+	 *  Serve requests on a Unix domain socket at path, which is replaced
+	 *  if it exists. Connections are served at the same time, each by a
+	 *  server from a pool, which keeps its matrices for the next one.
+	 */
+	int listener = listen_unix_socket(path);
+	if (listener < 0) {
+		std::perror("sudoku");
+		return 1;
+	}
+	auto pool = std::make_shared<sudoku::ServerPool>();
+	serve_connections(listener, [pool](std::istream& in, std::ostream& out) {
+		pool->serve(in, out);
+	});
+	std::perror("sudoku");
+	return 1;
+}
+
 int main(int argc, char* argv[]) {
+	if (argc > 1 and std::string(argv[1]) == "-d") {
+		if (argc > 2) {
+			return serve_socket(argv[2]);
+		}
+		// Answers are flushed by the server, not before every read
+		std::ios::sync_with_stdio(false);
+		std::cin.tie(nullptr);
+		sudoku::Server().serve(std::cin, std::cout);
+		return 0;
+	}
 	std::string puzzle = argc > 1 ? argv[argc-1] : "";
 	bool use_x = false;
 	switch (argc) {
@@ -18,7 +50,10 @@ int main(int argc, char* argv[]) {
 		case 1:
 		case 0:
 			std::cout << "usage: sudoku [options] <puzzle>\n";
+			std::cout << "       sudoku -d [socket]\n";
 			std::cout << "   x          Use cross rule\n";
+			std::cout << "   d          Answer puzzles line by line from stdin,\n";
+			std::cout << "              or from connections to a Unix socket\n";
 			return 0;
 	}
 	if (puzzle.size() == 81) {
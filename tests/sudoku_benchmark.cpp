@@ -1,19 +1,72 @@
 #include "sudoku.h"
 
+#include <chrono>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 int main() {
 	std::ifstream infile("tests/sudoku/top2365.sudoku");
-	std::ofstream outfile("tests/sudoku/top2365.solutions");
+	std::ifstream expected("tests/sudoku/top2365.solutions");
+	std::ostringstream solutions;
 
 	clock_t t1 = clock();
-	int count = sudoku::solve_file<9, false>(infile, outfile);
+	int count = sudoku::solve_file<9, false>(infile, solutions);
 	double dt = double(clock() - t1) / CLOCKS_PER_SEC;
-	if (count != 0) {
-		std::cout << "Solved " << count << " sudoku puzzles in " << dt << " seconds\n";
-		std::cout << "Average time: " << dt / count << " seconds\n";
+	if (count == 0) {
+		return 0;
 	}
-}
+	std::ostringstream reference;
+	reference << expected.rdbuf();
+	if (solutions.str() != reference.str()) {
+		std::cout << "Solutions differ from tests/sudoku/top2365.solutions\n";
+		return 1;
+	}
+	std::cout << "Solved " << count << " sudoku puzzles in " << dt << " seconds\n";
+	std::cout << "Average time: " << dt / count << " seconds\n";
+
+	infile.clear();
+	infile.seekg(0);
+	std::ostringstream bitboard_solutions;
+	clock_t t3 = clock();
+	sudoku::solve_file<9, false>(infile, bitboard_solutions,
+	                             sudoku::Engine::bitboard);
+	double bitboard_dt = double(clock() - t3) / CLOCKS_PER_SEC;
+	if (bitboard_solutions.str() != reference.str()) {
+		std::cout << "Bitboard solutions differ from tests/sudoku/top2365.solutions\n";
+		return 1;
+	}
+	std::cout << "Bitboard engine: " << bitboard_dt << " seconds, average "
+	          << bitboard_dt / count << " seconds\n";
 
+	if (stats_enabled) {
+		infile.clear();
+		infile.seekg(0);
+		std::ostringstream discard;
+		std::ofstream statsfile("tests/sudoku/top2365.stats");
+		sudoku::solve_file<9, false>(infile, discard, statsfile);
+		std::cout << "Search statistics written to tests/sudoku/top2365.stats\n";
+	}
+
+	// Throughput of the pipelined batch mode, which uses wall clock time
+	// since the work is spread over several threads.
+	infile.clear();
+	infile.seekg(0);
+	std::stringstream input;
+	input << infile.rdbuf();
+	unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned num_threads = 1;; num_threads *= 2) {
+		num_threads = std::min(num_threads, max_threads);
+		std::stringstream in(input.str()), out;
+		auto t2 = std::chrono::steady_clock::now();
+		sudoku::solve_file<9, false>(in, out, num_threads);
+		std::chrono::duration<double> wall = std::chrono::steady_clock::now() - t2;
+		std::cout << num_threads << " threads: "
+		          << count / wall.count() << " puzzles per second\n";
+		if (num_threads == max_threads) {
+			break;
+		}
+	}
+}
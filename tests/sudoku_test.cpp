@@ -0,0 +1,199 @@
+#include "socket.h"
+#include "sudoku.h"
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+template<int sz, bool use_cross_rule>
+bool is_solution(const std::string& puzzle, const std::string& solution) {
+    /* Check a grid against the rules and the clues of a puzzle */
+    const int block_height = (sz == 9 ? 3 : 2);
+    if (solution.size() != size_t(sz * sz)) {
+        return false;
+    }
+    for (int a = 0; a < sz * sz; ++a) {
+        if (puzzle[a] >= '1' and puzzle[a] < '1' + sz and puzzle[a] != solution[a]) {
+            return false;
+        }
+        for (int b = a + 1; b < sz * sz; ++b) {
+            int i1 = a / sz, j1 = a % sz, i2 = b / sz, j2 = b % sz;
+            bool peers = i1 == i2 or j1 == j2 or
+                (j1 / 3 == j2 / 3 and i1 / block_height == i2 / block_height) or
+                (use_cross_rule and i1 == j1 and i2 == j2) or
+                (use_cross_rule and i1 + j1 == sz - 1 and i2 + j2 == sz - 1);
+            if (peers and solution[a] == solution[b]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool bitboard_top95() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::ostringstream dlx, bitboard;
+    sudoku::solve_file<9, false>(infile, dlx);
+    infile.clear();
+    infile.seekg(0);
+    sudoku::solve_file<9, false>(infile, bitboard, sudoku::Engine::bitboard);
+    return not dlx.str().empty() and dlx.str() == bitboard.str();
+}
+
+bool cells_top95() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::ostringstream dlx, cells;
+    sudoku::solve_file<9, false>(infile, dlx);
+    infile.clear();
+    infile.seekg(0);
+    sudoku::solve_file<9, false>(infile, cells, sudoku::Engine::cells);
+    return not dlx.str().empty() and dlx.str() == cells.str();
+}
+
+bool bitboard_threads() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::stringstream input;
+    input << infile.rdbuf();
+    std::stringstream in1(input.str()), in2(input.str());
+    std::ostringstream serial, threaded;
+    sudoku::solve_file<9, false>(in1, serial, sudoku::Engine::bitboard);
+    sudoku::solve_file<9, false>(in2, threaded, 3, sudoku::Engine::bitboard);
+    return serial.str() == threaded.str();
+}
+
+bool bitboard_variants() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    sudoku::Bitboard<9, true> B9x;
+    sudoku::Bitboard<6, false> B6;
+    sudoku::Bitboard<6, true> B6x;
+    std::string empty9(81, '.'), empty6(36, '.');
+    std::string puzzle6 = sudoku::format_solution<6>(
+        sudoku::puzzle_matrix<6>(empty6).solve());
+    for (int i = 0; i < 36; i += 1 + i % 3) {
+        puzzle6[i] = '.';
+    }
+    return is_solution<9, true>(empty9, B9x.solve(empty9)) and
+           is_solution<6, false>(empty6, B6.solve(empty6)) and
+           is_solution<6, true>(empty6, B6x.solve(empty6)) and
+           is_solution<6, false>(puzzle6, B6.solve(puzzle6));
+}
+
+bool bitboard_contradiction() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    sudoku::Bitboard<9> B;
+    std::string clash = "11" + std::string(79, '.');
+    // Valid clues, but no digit fits in the last cell of the first row
+    std::string stuck = "12345678." + std::string(63, '.') + "........9";
+    return B.solve(clash).empty() and B.solve(stuck).empty() and
+           sudoku::format_solution<9>(sudoku::puzzle_matrix<9>(stuck).solve()).empty();
+}
+
+bool server() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Requests of every variant in one stream, answered in order
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::string puzzle9;
+    std::getline(infile, puzzle9);
+    std::string empty9(81, '.'), empty6(36, '.');
+    std::string clash = "11" + std::string(79, '.');
+    std::stringstream requests;
+    requests << puzzle9 << '\n' << "x " << empty6 << '\n' << "123\n"
+             << clash << "\r\n" << "x " << empty9 << '\n' << puzzle9 << '\n';
+    std::ostringstream answers;
+    sudoku::Server server;
+    if (server.serve(requests, answers) != 6) {
+        return false;
+    }
+    std::istringstream lines(answers.str());
+    std::string a[6];
+    for (std::string& line : a) {
+        std::getline(lines, line);
+    }
+    return is_solution<9, false>(puzzle9, a[0]) and
+           is_solution<6, true>(empty6, a[1]) and a[2] == "error" and
+           a[3] == "none" and is_solution<9, true>(empty9, a[4]) and
+           a[5] == a[0] and not std::getline(lines, a[0]);
+}
+
+bool server_malformed() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Characters other than blanks and the digits of the grid are refused
+    sudoku::Server server;
+    std::string digit0 = std::string(80, '.') + "0";
+    return server.answer(std::string(36, '9')) == "error" and
+           server.answer(std::string(81, 'z')) == "error" and
+           server.answer("x " + std::string(36, '7')) == "error" and
+           server.answer(digit0) == "error" and
+           server.answer(std::string(81, '9')) == "none" and
+           server.answer(std::string(36, '6')) == "none";
+}
+
+bool server_socket() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Two connections in turn, each sending every request before reading
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::ostringstream requests;
+    for (std::string line; std::getline(infile, line);) {
+        if (line.size() == 81) {
+            requests << line << '\n';
+        }
+    }
+    infile.clear();
+    infile.seekg(0);
+    std::ostringstream expected;
+    sudoku::solve_file<9, false>(infile, expected);
+
+    std::string path = "/tmp/sudoku_test." + std::to_string(getpid());
+    int listener = listen_unix_socket(path);
+    if (listener < 0) {
+        return false;
+    }
+    sudoku::ServerPool pool;
+    std::thread acceptor(serve_connections, listener,
+                         [&pool](std::istream& in, std::ostream& out) {
+                             pool.serve(in, out);
+                         });
+    bool ok = true;
+    for (int k = 0; k < 2; ++k) {
+        int fd = connect_unix_socket(path);
+        if (fd < 0) {
+            ok = false;
+            break;
+        }
+        SocketBuf buf(fd);
+        std::ostream out(&buf);
+        out << requests.str() << std::flush;
+        shutdown(fd, SHUT_WR);
+        std::istream in(&buf);
+        std::ostringstream answers;
+        answers << in.rdbuf();
+        ok = ok and answers.str() == expected.str();
+    }
+    shutdown(listener, SHUT_RDWR);
+    acceptor.join();
+    close(listener);
+    unlink(path.c_str());
+    // The server of the first connection was kept for the second
+    return ok and not expected.str().empty() and pool.idle_servers() == 1;
+}
+
+int main() {
+    assert(bitboard_top95());
+    assert(cells_top95());
+    assert(bitboard_threads());
+    assert(bitboard_variants());
+    assert(bitboard_contradiction());
+    assert(server());
+    assert(server_malformed());
+    assert(server_socket());
+    std::cout << "All tests passed!\n";
+}
@@ -0,0 +1,132 @@
+#include "bitset.h"
+#include "cells.h"
+#include "memo.h"
+#include "pentomino.h"
+#include "sudoku.h"
+#include "symmetry.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ *  Independent matrices and engines used from several threads at once,
+ *  which must give the same results as one at a time. Build with
+ *  make TSAN=1 threads_test to have ThreadSanitizer check there is no
+ *  state shared between them.
+ */
+
+const unsigned num_threads = 8;
+
+template<typename Work>
+void run_threads(Work work) {
+    /* Call work(t) for each thread index t, all at the same time */
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; ++t) {
+        threads.emplace_back(work, t);
+    }
+    for (std::thread& th : threads) {
+        th.join();
+    }
+}
+
+std::set<std::vector<size_t>> row_indices(const SparseMatrix& m,
+                                          const std::vector<std::vector<HeadNode*>>& all) {
+    std::set<std::vector<size_t>> ret;
+    for (const auto& solution : all) {
+        std::vector<size_t> rows;
+        for (HeadNode *n : solution) {
+            rows.push_back(n - m.rows.data());
+        }
+        std::sort(rows.begin(), rows.end());
+        ret.insert(rows);
+    }
+    return ret;
+}
+
+bool sudoku_engines() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Every thread solves the puzzles with its own solver of each engine
+    std::ifstream infile("tests/sudoku/top95.sudoku");
+    std::vector<std::string> puzzles;
+    for (std::string line; std::getline(infile, line) and puzzles.size() < 10;) {
+        puzzles.push_back(line);
+    }
+    const sudoku::Engine engines[] = {
+        sudoku::Engine::dlx, sudoku::Engine::bitboard, sudoku::Engine::cells,
+    };
+    std::vector<std::string> expected;
+    auto solve = sudoku::puzzle_solver<9, false>(sudoku::Engine::dlx);
+    for (const std::string& puzzle : puzzles) {
+        expected.push_back(solve(puzzle));
+    }
+    std::vector<char> ok(num_threads, true);
+    run_threads([&](unsigned t) {
+        auto own = sudoku::puzzle_solver<9, false>(engines[t % 3]);
+        for (size_t i = 0; i < puzzles.size(); ++i) {
+            size_t k = (i + t) % puzzles.size();
+            ok[t] = ok[t] and own(puzzles[k]) == expected[k];
+        }
+    });
+    return not expected[0].empty() and
+           std::find(ok.begin(), ok.end(), false) == ok.end();
+}
+
+bool matrix_copies() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Copies of one matrix, searched by every engine in parallel
+    SparseMatrix m = pentomino::create_matrix();
+    Symmetry(m, pentomino::board_symmetries()).reduce();
+    auto expected = row_indices(m, m.solve_all());
+    std::vector<char> ok(num_threads, true);
+    run_threads([&](unsigned t) {
+        SparseMatrix own = m;
+        switch (t % 4) {
+          case 0:
+            ok[t] = row_indices(own, own.solve_all()) == expected;
+            break;
+          case 1:
+            ok[t] = row_indices(own, BitsetSolver(own).solve_all()) == expected;
+            break;
+          case 2:
+            ok[t] = row_indices(own, DancingCells(own).solve_all()) == expected;
+            break;
+          default:
+            ok[t] = MemoCounter(own, 1 << 16).count() == Natural(expected.size());
+            break;
+        }
+    });
+    return expected.size() == 65 and std::find(ok.begin(), ok.end(), false) == ok.end();
+}
+
+bool nested_threads() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Parallel and racing searches, each on a matrix of its own thread
+    SparseMatrix m = pentomino::create_matrix();
+    Symmetry(m, pentomino::board_symmetries()).reduce();
+    auto expected = row_indices(m, m.solve_all());
+    std::vector<char> ok(num_threads, true);
+    run_threads([&](unsigned t) {
+        SparseMatrix own = pentomino::create_matrix();
+        Symmetry(own, pentomino::board_symmetries()).reduce();
+        if (t % 2 == 0) {
+            ok[t] = row_indices(own, own.solve_all(2)) == expected;
+        } else {
+            auto found = row_indices(own, {own.solve_race({0, t})});
+            ok[t] = expected.count(*found.begin()) == 1;
+        }
+    });
+    return std::find(ok.begin(), ok.end(), false) == ok.end();
+}
+
+int main() {
+    assert(sudoku_engines());
+    assert(matrix_copies());
+    assert(nested_threads());
+    std::cout << "All tests passed!\n";
+}
@@ -0,0 +1,117 @@
+#include "timetabler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+bool is_timetable(const TimeTable& t, int num_rooms, const std::vector<size_t>& lo,
+                  const std::vector<size_t>& hi) {
+    /* Check the counts of each type and that no slot is used twice */
+    std::vector<size_t> count(lo.size());
+    std::vector<bool> used(num_rooms * TimeTable::hours);
+    for (size_t id : t.timetable()) {
+        const Class& c = t.placement(id);
+        if (not t.offered(id)) {
+            return false;
+        }
+        ++count[c.type - 1];
+        for (int h = c.time; h < c.time + c.length; ++h) {
+            if (used[c.room * TimeTable::hours + h]) {
+                return false;
+            }
+            used[c.room * TimeTable::hours + h] = true;
+        }
+    }
+    for (size_t i = 0; i < lo.size(); ++i) {
+        if (count[i] < lo[i] or count[i] > hi[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool schedule() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    TimeTable t(1, 2);
+    t.add({1, 0, 9, 1});
+    size_t q = t.add({1, 0, 5, 1});
+    size_t r = t.add({2, 0, 8, 2});
+    if (t.add({2, 0, 8, 2}) != r or t.size() != 3) {
+        return false;
+    }
+    std::vector<size_t> once(2, 1);
+    if (not t.solve() or not is_timetable(t, 1, once, once) or
+        t.timetable() != std::vector<size_t>{q, r}) {
+        return false;
+    }
+    // Moving the class of type 2 leaves type 1 where it was, although
+    // solving from scratch would now find the first placement of type 1
+    size_t s = t.add({2, 0, 20, 1});
+    t.withdraw(r);
+    if (not t.solve() or t.timetable() != std::vector<size_t>{q, s}) {
+        return false;
+    }
+    t.withdraw(s);
+    if (t.solve() or not t.timetable().empty()) {
+        return false;
+    }
+    return t.add({2, 0, 8, 2}) == r and t.offered(r) and t.solve() and
+           t.timetable() == std::vector<size_t>{q, r};
+}
+
+bool multiplicity() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    TimeTable t(2, 2);
+    t.require(1, 2, 3);
+    t.require(2, 0, 1);
+    for (int h = 0; h < 4; ++h) {
+        t.add({1, 0, 2 * h, 2});
+        t.add({2, 1, h, 1});
+    }
+    std::vector<size_t> lo{2, 0}, hi{3, 1};
+    return t.solve() and is_timetable(t, 2, lo, hi);
+}
+
+bool edits() {
+    std::cout << "Running test: " << __PRETTY_FUNCTION__ << '\n';
+    // Random edits, each solved incrementally and from scratch
+    const int num_rooms = 3, num_types = 12;
+    std::minstd_rand rng(1);
+    TimeTable t(num_rooms, num_types);
+    std::vector<size_t> once(num_types, 1);
+    for (int i = 0; i < 60; ++i) {
+        int length = 1 + rng() % 4;
+        Class c{1 + int(rng() % num_types), int(rng() % num_rooms),
+                int(rng() % (TimeTable::hours - length + 1)), length};
+        t.add(c);
+    }
+    for (int edit = 0; edit < 200; ++edit) {
+        size_t id = rng() % t.size();
+        if (t.offered(id)) {
+            t.withdraw(id);
+        } else {
+            t.add(t.placement(id));
+        }
+        TimeTable fresh(num_rooms, num_types);
+        for (size_t i = 0; i < t.size(); ++i) {
+            if (t.offered(i)) {
+                fresh.add(t.placement(i));
+            }
+        }
+        bool solved = t.solve();
+        if (solved != fresh.solve() or
+            (solved and not is_timetable(t, num_rooms, once, once))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    assert(schedule());
+    assert(multiplicity());
+    assert(edits());
+    std::cout << "All tests passed!\n";
+}